@@ -0,0 +1,372 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Throughput benchmarks for the AstroData I/O and generator paths.
+// Results are written as JSON, using the same schema as Google Benchmark.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+
+#include <Observation.hpp>
+#include <BatchLayout.hpp>
+#include <ReadData.hpp>
+#include <Generator.hpp>
+#include <SynthesizedBeams.hpp>
+
+namespace {
+
+struct BenchmarkResult {
+  std::string name;
+  uint64_t iterations;
+  double realTime;
+  double bytesPerSecond;
+  double itemsPerSecond;
+};
+
+struct BenchmarkOptions {
+  std::vector<unsigned int> channels;
+  std::vector<unsigned int> samples;
+  unsigned int batches;
+  unsigned int padding;
+  double minTime;
+  std::string directory;
+  std::string output;
+};
+
+// Run the function until minTime seconds have passed, and compute throughput per iteration
+BenchmarkResult runBenchmark(const std::string & name, const BenchmarkOptions & options, const uint64_t bytes, const uint64_t items, const std::function<void()> & function) {
+  BenchmarkResult result;
+  double elapsed = 0.0;
+
+  result.name = name;
+  result.iterations = 0;
+  // Warm up caches and page cache
+  function();
+  while ( elapsed < options.minTime ) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    function();
+    elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.iterations++;
+  }
+  result.realTime = (elapsed / result.iterations) * 1.0e9;
+  result.bytesPerSecond = (bytes * result.iterations) / elapsed;
+  result.itemsPerSecond = (items * result.iterations) / elapsed;
+  std::cerr << name << ": " << result.bytesPerSecond / 1.0e9 << " GB/s, " << result.itemsPerSecond / 1.0e6 << " Msamples/s" << std::endl;
+  return result;
+}
+
+template<typename T> void deleteBatches(std::vector<std::vector<T> *> & data) {
+  for ( unsigned int batch = 0; batch < data.size(); batch++ ) {
+    delete data.at(batch);
+    data.at(batch) = 0;
+  }
+}
+
+// Write generated batches as a SIGPROC file, time-major from the highest to the lowest frequency channel
+template<typename T> void writeSIGPROC(const AstroData::BatchLayout<T> & layout, const std::vector<std::vector<T> *> & data, const unsigned int headerBytes, const std::string & filename) {
+  std::ofstream outputFile(filename.c_str(), std::ios::binary);
+  std::vector<uint8_t> buffer(layout.getNrInputBytesPerBatch());
+  const unsigned int samplesPerElement = layout.getNrSamplesPerElement();
+
+  if ( !outputFile ) {
+    throw AstroData::FileError("ERROR: impossible to create \"" + filename + "\"");
+  }
+  outputFile << std::string(headerBytes, ' ');
+  for ( unsigned int batch = 0; batch < data.size(); batch++ ) {
+    std::fill(buffer.begin(), buffer.end(), 0);
+    for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
+      for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
+        uint64_t item = (static_cast<uint64_t>(sample) * layout.getNrChannels()) + ((layout.getNrChannels() - 1) - channel);
+        T element = data.at(batch)->at(layout.getIndex(channel, sample / samplesPerElement));
+
+        if ( layout.getNrInputBits() >= 8 ) {
+          std::memcpy(reinterpret_cast<void *>(buffer.data() + (item * sizeof(T))), reinterpret_cast<const void *>(&element), sizeof(T));
+        } else {
+          const uint8_t mask = (1 << layout.getNrInputBits()) - 1;
+          uint8_t value = (static_cast<uint8_t>(element) >> ((sample % samplesPerElement) * layout.getNrInputBits())) & mask;
+
+          buffer.at(item / samplesPerElement) |= value << ((item % samplesPerElement) * layout.getNrInputBits());
+        }
+      }
+    }
+    outputFile.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+  }
+  outputFile.close();
+}
+
+std::string benchmarkName(const std::string & function, const unsigned int bits, const AstroData::Observation & observation) {
+  std::stringstream name;
+
+  name << function << "/bits:" << bits << "/channels:" << observation.getNrChannels() << "/samples:" << observation.getNrSamplesPerBatch();
+  return name.str();
+}
+
+template<typename T> void benchmarkSIGPROC(const BenchmarkOptions & options, const AstroData::Observation & observation, const uint8_t inputBits, std::vector<BenchmarkResult> & results) {
+  const unsigned int headerBytes = 363;
+  const std::string filename = options.directory + "/astrodata_bench_" + std::to_string(inputBits) + ".fil";
+  AstroData::BatchLayout<T> layout(observation, options.padding, inputBits);
+  std::vector<std::vector<T> *> data(observation.getNrBatches());
+  const uint64_t items = static_cast<uint64_t>(observation.getNrBatches()) * observation.getNrChannels() * observation.getNrSamplesPerBatch();
+
+  if ( observation.getNrSamplesPerBatch() % layout.getNrSamplesPerElement() != 0 ) {
+    return;
+  }
+  AstroData::generateSinglePulse(layout, 8, 10.0f, observation, data, true);
+  writeSIGPROC(layout, data, headerBytes, filename);
+  deleteBatches(data);
+  results.push_back(runBenchmark(benchmarkName("readSIGPROC", inputBits, observation), options, layout.getNrInputBytesPerBatch() * observation.getNrBatches(), items, [&]() {
+    AstroData::readSIGPROC(layout, observation, headerBytes, filename, data);
+    deleteBatches(data);
+  }));
+  std::remove(filename.c_str());
+}
+
+template<typename T> void benchmarkGenerators(const BenchmarkOptions & options, const AstroData::Observation & observation, const uint8_t inputBits, std::vector<BenchmarkResult> & results) {
+  AstroData::BatchLayout<T> layout(observation, options.padding, inputBits);
+  std::vector<std::vector<T> *> data(observation.getNrBatches());
+  const uint64_t items = static_cast<uint64_t>(observation.getNrBatches()) * observation.getNrChannels() * observation.getNrSamplesPerBatch();
+
+  if ( observation.getNrSamplesPerBatch() % layout.getNrSamplesPerElement() != 0 ) {
+    return;
+  }
+  if ( inputBits >= 8 ) {
+    results.push_back(runBenchmark(benchmarkName("generatePulsar", inputBits, observation), options, layout.getNrBytesPerBatch() * observation.getNrBatches(), items, [&]() {
+      AstroData::generatePulsar(layout, observation.getNrSamplesPerBatch() / 4, 8, 10.0f, observation, data, true);
+      deleteBatches(data);
+    }));
+  }
+  results.push_back(runBenchmark(benchmarkName("generateSinglePulse", inputBits, observation), options, layout.getNrBytesPerBatch() * observation.getNrBatches(), items, [&]() {
+    AstroData::generateSinglePulse(layout, 8, 10.0f, observation, data, true);
+    deleteBatches(data);
+  }));
+}
+
+// Stand-in for readPSRDADA: one block copied from a shared memory buffer into a batch
+void benchmarkPSRDADA(const BenchmarkOptions & options, const AstroData::Observation & observation, std::vector<BenchmarkResult> & results) {
+  const uint64_t blockBytes = static_cast<uint64_t>(observation.getNrChannels()) * observation.getNrSamplesPerBatch();
+  std::vector<char> block(blockBytes, 8);
+  std::vector<uint8_t> data(blockBytes);
+
+  results.push_back(runBenchmark(benchmarkName("readPSRDADABlock", 8, observation), options, blockBytes, blockBytes, [&]() {
+    std::memcpy(reinterpret_cast<void *>(data.data()), reinterpret_cast<const void *>(block.data()), data.size() * sizeof(uint8_t));
+  }));
+}
+
+void benchmarkBeamMapping(const BenchmarkOptions & options, const AstroData::Observation & observation, std::vector<BenchmarkResult> & results) {
+  AstroData::BatchLayout<unsigned int> layout(observation, options.padding);
+  std::vector<unsigned int> beamMapping(static_cast<uint64_t>(observation.getNrSynthesizedBeams()) * layout.getBeamMappingStride());
+  const uint64_t items = static_cast<uint64_t>(observation.getNrSynthesizedBeams()) * observation.getNrChannels();
+
+  results.push_back(runBenchmark(benchmarkName("generateBeamMapping", 32, observation), options, items * sizeof(unsigned int), items, [&]() {
+    AstroData::generateBeamMapping(layout, observation, beamMapping);
+  }));
+}
+
+#ifdef HAVE_HDF5
+// Write a minimal LOFAR HDF5 header and matching raw file
+void writeLOFAR(const AstroData::Observation & observation, const unsigned int nrSubbands, const std::string & headerFilename, const std::string & rawFilename) {
+  const unsigned int nrChannels = observation.getNrChannels() / nrSubbands;
+  const double integrationTime = observation.getNrBatches();
+  const double minFreq = observation.getMinFreq();
+  const double channelWidth = observation.getChannelBandwidth() * 1000000.0;
+  const unsigned int nrSamples = observation.getNrBatches() * observation.getNrSamplesPerBatch();
+  const unsigned int nrBeams = 1;
+  const unsigned int nrStations = 1;
+  H5::DataSpace scalar(H5S_SCALAR);
+  H5::H5File headerFile(headerFilename, H5F_ACC_TRUNC);
+
+  H5::Group root = headerFile.openGroup("/");
+  root.createAttribute("OBSERVATION_FREQUENCY_MIN", H5::PredType::NATIVE_DOUBLE, scalar).write(H5::PredType::NATIVE_DOUBLE, &minFreq);
+  H5::Group sap = root.createGroup("SUB_ARRAY_POINTING_000");
+  sap.createAttribute("TOTAL_INTEGRATION_TIME", H5::PredType::NATIVE_DOUBLE, scalar).write(H5::PredType::NATIVE_DOUBLE, &integrationTime);
+  sap.createAttribute("NOF_BEAMS", H5::PredType::NATIVE_UINT, scalar).write(H5::PredType::NATIVE_UINT, &nrBeams);
+  H5::Group beam = sap.createGroup("BEAM_000");
+  beam.createAttribute("NOF_SAMPLES", H5::PredType::NATIVE_UINT, scalar).write(H5::PredType::NATIVE_UINT, &nrSamples);
+  beam.createAttribute("NOF_STATIONS", H5::PredType::NATIVE_UINT, scalar).write(H5::PredType::NATIVE_UINT, &nrStations);
+  beam.createAttribute("CHANNELS_PER_SUBBAND", H5::PredType::NATIVE_UINT, scalar).write(H5::PredType::NATIVE_UINT, &nrChannels);
+  beam.createAttribute("CHANNEL_WIDTH", H5::PredType::NATIVE_DOUBLE, scalar).write(H5::PredType::NATIVE_DOUBLE, &channelWidth);
+  H5::DataSet stokes = beam.createDataSet("STOKES_0", H5::PredType::NATIVE_FLOAT, scalar);
+  stokes.createAttribute("NOF_SUBBANDS", H5::PredType::NATIVE_UINT, scalar).write(H5::PredType::NATIVE_UINT, &nrSubbands);
+  headerFile.close();
+
+  std::ofstream rawFile(rawFilename.c_str(), std::ios::binary);
+  std::vector<char> buffer(static_cast<uint64_t>(observation.getNrChannels()) * observation.getNrSamplesPerBatch() * 4);
+  for ( uint64_t word = 0; word < buffer.size() / 4; word++ ) {
+    float value = static_cast<float>(std::rand() % 25);
+
+    std::memcpy(reinterpret_cast<void *>(buffer.data() + (word * 4)), reinterpret_cast<const void *>(&value), 4);
+    isa::utils::bigEndianToLittleEndian(buffer.data() + (word * 4));
+  }
+  for ( unsigned int batch = 0; batch < observation.getNrBatches(); batch++ ) {
+    rawFile.write(buffer.data(), buffer.size());
+  }
+  rawFile.close();
+}
+
+void benchmarkLOFAR(const BenchmarkOptions & options, const AstroData::Observation & observation, std::vector<BenchmarkResult> & results) {
+  const unsigned int nrSubbands = (observation.getNrChannels() % 16 == 0) ? observation.getNrChannels() / 16 : 1;
+  const std::string headerFilename = options.directory + "/astrodata_bench.h5";
+  const std::string rawFilename = options.directory + "/astrodata_bench.raw";
+  const uint64_t items = static_cast<uint64_t>(observation.getNrBatches()) * observation.getNrChannels() * observation.getNrSamplesPerBatch();
+  std::vector<std::vector<float> *> data;
+
+  writeLOFAR(observation, nrSubbands, headerFilename, rawFilename);
+  results.push_back(runBenchmark(benchmarkName("readLOFAR", 32, observation), options, items * 4, items, [&]() {
+    AstroData::Observation lofarObservation;
+
+    AstroData::readLOFAR(headerFilename, rawFilename, lofarObservation, options.padding, data);
+    deleteBatches(data);
+  }));
+  std::remove(headerFilename.c_str());
+  std::remove(rawFilename.c_str());
+}
+#endif // HAVE_HDF5
+
+std::vector<unsigned int> parseList(const std::string & list) {
+  std::vector<unsigned int> values;
+  std::stringstream listStream(list);
+  std::string item;
+
+  while ( std::getline(listStream, item, ',') ) {
+    values.push_back(std::stoul(item));
+  }
+  return values;
+}
+
+void writeJSON(std::ostream & output, const BenchmarkOptions & options, const std::vector<BenchmarkResult> & results) {
+  std::time_t now = std::time(0);
+  char date[64];
+
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+  output << "{" << std::endl;
+  output << "  \"context\": {" << std::endl;
+  output << "    \"date\": \"" << date << "\"," << std::endl;
+  output << "    \"library\": \"astrodata\"," << std::endl;
+  output << "    \"batches\": " << options.batches << "," << std::endl;
+  output << "    \"padding\": " << options.padding << std::endl;
+  output << "  }," << std::endl;
+  output << "  \"benchmarks\": [" << std::endl;
+  for ( unsigned int result = 0; result < results.size(); result++ ) {
+    output << "    {" << std::endl;
+    output << "      \"name\": \"" << results.at(result).name << "\"," << std::endl;
+    output << "      \"iterations\": " << results.at(result).iterations << "," << std::endl;
+    output << "      \"real_time\": " << results.at(result).realTime << "," << std::endl;
+    output << "      \"time_unit\": \"ns\"," << std::endl;
+    output << "      \"bytes_per_second\": " << results.at(result).bytesPerSecond << "," << std::endl;
+    output << "      \"items_per_second\": " << results.at(result).itemsPerSecond << std::endl;
+    output << "    }" << ((result + 1 < results.size()) ? "," : "") << std::endl;
+  }
+  output << "  ]" << std::endl;
+  output << "}" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char * argv[]) {
+  BenchmarkOptions options;
+  std::vector<BenchmarkResult> results;
+
+  options.channels = parseList("512,1536");
+  options.samples = parseList("12500,25000");
+  options.batches = 4;
+  options.padding = 64;
+  options.minTime = 0.5;
+  options.directory = "/tmp";
+  for ( int argument = 1; argument < argc; argument++ ) {
+    std::string name = argv[argument];
+
+    if ( argument + 1 >= argc ) {
+      std::cerr << "Usage: " << argv[0] << " [-channels 512,1536] [-samples 12500,25000] [-batches 4] [-padding 64] [-min_time 0.5] [-directory /tmp] [-output results.json]" << std::endl;
+      return 1;
+    }
+    std::string value = argv[++argument];
+    if ( name == "-channels" ) {
+      options.channels = parseList(value);
+    } else if ( name == "-samples" ) {
+      options.samples = parseList(value);
+    } else if ( name == "-batches" ) {
+      options.batches = std::stoul(value);
+    } else if ( name == "-padding" ) {
+      options.padding = std::stoul(value);
+    } else if ( name == "-min_time" ) {
+      options.minTime = std::stod(value);
+    } else if ( name == "-directory" ) {
+      options.directory = value;
+    } else if ( name == "-output" ) {
+      options.output = value;
+    } else {
+      std::cerr << "Unknown option " << name << std::endl;
+      return 1;
+    }
+  }
+
+  if ( options.batches < 2 ) {
+    std::cerr << "At least two batches are necessary." << std::endl;
+    return 1;
+  }
+
+  try {
+    for ( unsigned int channels = 0; channels < options.channels.size(); channels++ ) {
+      for ( unsigned int samples = 0; samples < options.samples.size(); samples++ ) {
+        AstroData::Observation observation;
+
+        observation.setNrBatches(options.batches);
+        observation.setNrSamplesPerBatch(options.samples.at(samples));
+        observation.setFrequencyRange(1, options.channels.at(channels), 1250.0f, 300.0f / options.channels.at(channels));
+        observation.setSamplingTime(1.0f / options.samples.at(samples));
+        observation.setNrBeams(12);
+        observation.setNrSynthesizedBeams(options.channels.at(channels));
+
+        benchmarkSIGPROC<uint8_t>(options, observation, 1, results);
+        benchmarkSIGPROC<uint8_t>(options, observation, 2, results);
+        benchmarkSIGPROC<uint8_t>(options, observation, 4, results);
+        benchmarkSIGPROC<uint8_t>(options, observation, 8, results);
+        benchmarkSIGPROC<uint16_t>(options, observation, 16, results);
+        benchmarkSIGPROC<float>(options, observation, 32, results);
+#ifdef HAVE_HDF5
+        benchmarkLOFAR(options, observation, results);
+#endif // HAVE_HDF5
+        benchmarkPSRDADA(options, observation, results);
+        benchmarkGenerators<uint8_t>(options, observation, 2, results);
+        benchmarkGenerators<uint8_t>(options, observation, 8, results);
+        benchmarkGenerators<float>(options, observation, 32, results);
+        benchmarkBeamMapping(options, observation, results);
+      }
+    }
+  } catch ( std::exception & err ) {
+    std::cerr << err.what() << std::endl;
+    return 1;
+  }
+
+  if ( options.output.empty() ) {
+    writeJSON(std::cout, options, results);
+  } else {
+    std::ofstream outputFile(options.output.c_str());
+
+    writeJSON(outputFile, options, results);
+  }
+  return 0;
+}
+
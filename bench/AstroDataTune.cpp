@@ -0,0 +1,123 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tune the padding of the host, and store it and the vector width in the configuration files.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Observation.hpp>
+#include <Platform.hpp>
+#include <Tuning.hpp>
+
+namespace {
+
+std::vector<unsigned int> parseList(const std::string & list) {
+  std::vector<unsigned int> values;
+  std::stringstream listStream(list);
+  std::string item;
+
+  while ( std::getline(listStream, item, ',') ) {
+    values.push_back(std::stoul(item));
+  }
+  return values;
+}
+
+} // namespace
+
+int main(int argc, char * argv[]) {
+  unsigned int channels = 1536;
+  unsigned int samples = 25000;
+  unsigned int batches = 2;
+  double minTime = 0.1;
+  std::string deviceName;
+  std::string paddingFilename;
+  std::string vectorFilename;
+  std::vector<unsigned int> paddings;
+  AstroData::CPUInfo cpu = AstroData::getCPUInfo();
+
+  for ( int argument = 1; argument < argc; argument++ ) {
+    std::string name = argv[argument];
+
+    if ( argument + 1 >= argc ) {
+      std::cerr << "Usage: " << argv[0] << " [-channels 1536] [-samples 25000] [-batches 2] [-min_time 0.1] [-paddings 64,128] [-device name] [-padding_file padding.conf] [-vector_file vector.conf]" << std::endl;
+      return 1;
+    }
+    std::string value = argv[++argument];
+    if ( name == "-channels" ) {
+      channels = std::stoul(value);
+    } else if ( name == "-samples" ) {
+      samples = std::stoul(value);
+    } else if ( name == "-batches" ) {
+      batches = std::stoul(value);
+    } else if ( name == "-min_time" ) {
+      minTime = std::stod(value);
+    } else if ( name == "-paddings" ) {
+      paddings = parseList(value);
+    } else if ( name == "-device" ) {
+      deviceName = value;
+    } else if ( name == "-padding_file" ) {
+      paddingFilename = value;
+    } else if ( name == "-vector_file" ) {
+      vectorFilename = value;
+    } else {
+      std::cerr << "Unknown option " << name << std::endl;
+      return 1;
+    }
+  }
+  if ( deviceName.empty() ) {
+    deviceName = AstroData::getDeviceName(cpu);
+  }
+  if ( paddings.empty() ) {
+    paddings = AstroData::getCandidatePaddings(cpu);
+  }
+
+  std::cerr << "Device: " << deviceName << " (" << cpu.model << ")" << std::endl;
+  std::cerr << "Vector width: " << cpu.vectorWidth << " B, cache line: " << cpu.cacheLineSize << " B" << std::endl;
+  for ( unsigned int cache = 0; cache < cpu.caches.size(); cache++ ) {
+    std::cerr << "L" << cpu.caches.at(cache).level << ": " << cpu.caches.at(cache).size / 1024 << " KiB, " << cpu.caches.at(cache).ways << " ways" << std::endl;
+  }
+  try {
+    AstroData::Observation observation;
+    std::vector<AstroData::TuningResult> results;
+
+    observation.setNrBatches(batches);
+    observation.setNrSamplesPerBatch(samples);
+    observation.setFrequencyRange(1, channels, 1250.0f, 300.0f / channels);
+    observation.setNrBeams(12);
+    observation.setNrSynthesizedBeams(channels);
+    results = AstroData::tunePadding(observation, paddings, minTime);
+    for ( unsigned int result = 0; result < results.size(); result++ ) {
+      std::cerr << "Padding " << results.at(result).padding << " B: " << results.at(result).time * 1.0e3 << " ms" << std::endl;
+    }
+    if ( paddingFilename.empty() ) {
+      std::cout << "padding: " << deviceName << " " << results.front().padding << std::endl;
+    } else {
+      AstroData::writeDeviceConf(paddingFilename, deviceName, results.front().padding);
+    }
+    if ( vectorFilename.empty() ) {
+      std::cout << "vector: " << deviceName << " " << cpu.vectorWidth << std::endl;
+    } else {
+      AstroData::writeDeviceConf(vectorFilename, deviceName, cpu.vectorWidth);
+    }
+  } catch ( std::exception & err ) {
+    std::cerr << err.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
@@ -0,0 +1,139 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include <cstdint>
+
+#include "Conversion.hpp"
+
+
+#pragma once
+
+namespace AstroData {
+
+enum class BandpassEstimator {
+  // Median and median absolute deviation
+  Median,
+  // Mean and standard deviation, iteratively rejecting outliers
+  ClippedMean
+};
+
+// Per-channel baseline and scale, estimated from a rolling window of batches.
+// Every batch gives a location and spread per channel; the model is the median (Median) or mean (ClippedMean) of the last window batches.
+// Zapped channels, as filled by readZappedChannels, are neither estimated nor normalised.
+class Bandpass {
+public:
+  Bandpass(const unsigned int nrChannels, const unsigned int window, const BandpassEstimator estimator, const std::vector<unsigned int> & zappedChannels = std::vector<unsigned int>(), const float clipping = 3.0f);
+  ~Bandpass();
+
+  // Add one batch to the window and update the model
+  template<typename T, typename L> void update(const L & layout, const T * batch);
+  // Replace every sample with ((sample - baseline) / scale) * targetScale + targetOffset, in place
+  template<typename T, typename L> void normalize(const L & layout, T * batch, const float targetScale = 1.0f, const float targetOffset = 0.0f) const;
+  // Same normalisation as scale and offset per channel, e.g. for readConvertedSIGPROC to normalise while decoding
+  void getScaleAndOffset(std::vector<float> & scale, std::vector<float> & offset, const float targetScale = 1.0f, const float targetOffset = 0.0f) const;
+  const std::vector<float> & getBaseline() const;
+  const std::vector<float> & getScale() const;
+  bool isZapped(const unsigned int channel) const;
+  // Batches in the window, at most window
+  unsigned int getNrBatches() const;
+
+private:
+  // Location and spread of the samples of one channel of one batch; samples are reordered
+  void estimate(float * samples, const unsigned int nrSamples, float & location, float & spread) const;
+  void updateModel(const unsigned int channel);
+
+  unsigned int nrChannels;
+  unsigned int window;
+  BandpassEstimator estimator;
+  float clipping;
+  std::vector<uint8_t> zapped;
+  // Ring of window batches, [batch][channel]
+  std::vector<float> locations;
+  std::vector<float> spreads;
+  unsigned int nrBatches;
+  std::vector<float> baseline;
+  std::vector<float> scale;
+};
+
+// Implementations
+
+template<typename T, typename L> void Bandpass::update(const L & layout, const T * batch) {
+  const unsigned int slot = nrBatches % window;
+
+  if ( layout.getNrChannels() != nrChannels ) {
+    throw ObservationError("ERROR: the bandpass has " + std::to_string(nrChannels) + " channels, the batch " + std::to_string(layout.getNrChannels()));
+  }
+  #pragma omp parallel
+  {
+    std::vector<float> samples(layout.getNrSamplesPerBatch());
+
+    #pragma omp for schedule(static)
+    for ( unsigned int channel = 0; channel < nrChannels; channel++ ) {
+      if ( zapped.at(channel) ) {
+        continue;
+      }
+      loadChannel(layout, batch, channel, samples.data());
+      estimate(samples.data(), layout.getNrSamplesPerBatch(), locations.at((slot * nrChannels) + channel), spreads.at((slot * nrChannels) + channel));
+    }
+  }
+  nrBatches++;
+  #pragma omp parallel for schedule(static)
+  for ( unsigned int channel = 0; channel < nrChannels; channel++ ) {
+    if ( !zapped.at(channel) ) {
+      updateModel(channel);
+    }
+  }
+}
+
+template<typename T, typename L> void Bandpass::normalize(const L & layout, T * batch, const float targetScale, const float targetOffset) const {
+  std::vector<float> channelScale;
+  std::vector<float> channelOffset;
+
+  getScaleAndOffset(channelScale, channelOffset, targetScale, targetOffset);
+  #pragma omp parallel
+  {
+    std::vector<float> samples(layout.getNrSamplesPerBatch());
+
+    #pragma omp for schedule(static)
+    for ( unsigned int channel = 0; channel < nrChannels; channel++ ) {
+      if ( zapped.at(channel) ) {
+        continue;
+      }
+      loadChannel(layout, batch, channel, samples.data());
+      scaleChannel(layout.getNrSamplesPerBatch(), channelScale, channelOffset, channel, samples.data());
+      storeChannel(layout, samples.data(), channel, batch);
+    }
+  }
+}
+
+inline const std::vector<float> & Bandpass::getBaseline() const {
+  return baseline;
+}
+
+inline const std::vector<float> & Bandpass::getScale() const {
+  return scale;
+}
+
+inline bool Bandpass::isZapped(const unsigned int channel) const {
+  return zapped.at(channel) != 0;
+}
+
+inline unsigned int Bandpass::getNrBatches() const {
+  return std::min(nrBatches, window);
+}
+
+} // AstroData
+
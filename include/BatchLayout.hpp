@@ -0,0 +1,147 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <cstdint>
+
+#include "Observation.hpp"
+#include "Platform.hpp"
+#include "StaticLayout.hpp"
+
+
+#pragma once
+
+namespace AstroData {
+
+// Batch layout computed once at run time; same interface as StaticLayout
+template<typename T> class BatchLayout {
+public:
+  // Padding is in bytes; sub-byte samples are packed in elements of type T
+  BatchLayout(const Observation & observation, const unsigned int padding, const uint8_t inputBits = sizeof(T) * 8);
+  BatchLayout(const Observation & observation, const paddingConf & padding, const std::string & deviceName, const uint8_t inputBits = sizeof(T) * 8);
+  ~BatchLayout();
+
+  unsigned int getNrChannels() const;
+  unsigned int getNrSamplesPerBatch() const;
+  uint8_t getNrInputBits() const;
+  // Size in bytes of one element of the batch buffer
+  unsigned int getElementSize() const;
+  // Number of samples packed in one element
+  unsigned int getNrSamplesPerElement() const;
+  unsigned int getNrElementsPerChannel() const;
+  // Padded distance, in elements, between two channels
+  unsigned int getChannelStride() const;
+  uint64_t getNrElementsPerBatch() const;
+  uint64_t getNrBytesPerBatch() const;
+  // Size in bytes of one batch in the input file
+  uint64_t getNrInputBytesPerBatch() const;
+  uint64_t getIndex(const unsigned int channel, const unsigned int element) const;
+  // Padded distance between two synthesized beams in the beam mapping
+  unsigned int getBeamMappingStride() const;
+
+private:
+  void initialize(const Observation & observation, const unsigned int padding);
+
+  unsigned int nrChannels;
+  unsigned int nrSamplesPerBatch;
+  uint8_t inputBits;
+  unsigned int nrSamplesPerElement;
+  unsigned int nrElementsPerChannel;
+  unsigned int channelStride;
+  uint64_t nrElementsPerBatch;
+  uint64_t nrInputBytesPerBatch;
+  unsigned int beamMappingStride;
+};
+
+// Implementations
+template<typename T> BatchLayout<T>::BatchLayout(const Observation & observation, const unsigned int padding, const uint8_t inputBits) : inputBits(inputBits) {
+  initialize(observation, padding);
+}
+
+template<typename T> BatchLayout<T>::BatchLayout(const Observation & observation, const paddingConf & padding, const std::string & deviceName, const uint8_t inputBits) : inputBits(inputBits) {
+  initialize(observation, padding.at(deviceName));
+}
+
+template<typename T> BatchLayout<T>::~BatchLayout() {}
+
+template<typename T> void BatchLayout<T>::initialize(const Observation & observation, const unsigned int padding) {
+  nrChannels = observation.getNrChannels();
+  nrSamplesPerBatch = observation.getNrSamplesPerBatch();
+  // Samples of 8 bits or more are copied as they are, and must have the size of the elements
+  if ( inputBits >= 8 && inputBits != sizeof(T) * 8 ) {
+    throw ObservationError("ERROR: samples of " + std::to_string(inputBits) + " bits do not fit elements of " + std::to_string(sizeof(T) * 8) + " bits");
+  }
+  if ( inputBits < 8 ) {
+    nrSamplesPerElement = 8 / inputBits;
+  } else {
+    nrSamplesPerElement = 1;
+  }
+  nrElementsPerChannel = nrSamplesPerBatch / nrSamplesPerElement;
+  channelStride = staticPad(nrElementsPerChannel, padding / sizeof(T));
+  nrElementsPerBatch = static_cast<uint64_t>(nrChannels) * channelStride;
+  nrInputBytesPerBatch = (static_cast<uint64_t>(nrChannels) * nrSamplesPerBatch * inputBits) / 8;
+  beamMappingStride = staticPad(nrChannels, padding / sizeof(unsigned int));
+}
+
+template<typename T> inline unsigned int BatchLayout<T>::getNrChannels() const {
+  return nrChannels;
+}
+
+template<typename T> inline unsigned int BatchLayout<T>::getNrSamplesPerBatch() const {
+  return nrSamplesPerBatch;
+}
+
+template<typename T> inline uint8_t BatchLayout<T>::getNrInputBits() const {
+  return inputBits;
+}
+
+template<typename T> inline unsigned int BatchLayout<T>::getElementSize() const {
+  return sizeof(T);
+}
+
+template<typename T> inline unsigned int BatchLayout<T>::getNrSamplesPerElement() const {
+  return nrSamplesPerElement;
+}
+
+template<typename T> inline unsigned int BatchLayout<T>::getNrElementsPerChannel() const {
+  return nrElementsPerChannel;
+}
+
+template<typename T> inline unsigned int BatchLayout<T>::getChannelStride() const {
+  return channelStride;
+}
+
+template<typename T> inline uint64_t BatchLayout<T>::getNrElementsPerBatch() const {
+  return nrElementsPerBatch;
+}
+
+template<typename T> inline uint64_t BatchLayout<T>::getNrBytesPerBatch() const {
+  return nrElementsPerBatch * sizeof(T);
+}
+
+template<typename T> inline uint64_t BatchLayout<T>::getNrInputBytesPerBatch() const {
+  return nrInputBytesPerBatch;
+}
+
+template<typename T> inline uint64_t BatchLayout<T>::getIndex(const unsigned int channel, const unsigned int element) const {
+  return (static_cast<uint64_t>(channel) * channelStride) + element;
+}
+
+template<typename T> inline unsigned int BatchLayout<T>::getBeamMappingStride() const {
+  return beamMappingStride;
+}
+
+} // AstroData
+
@@ -0,0 +1,123 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "Observation.hpp"
+#include "StaticLayout.hpp"
+
+
+#pragma once
+
+namespace AstroData {
+
+// Sliding window over consecutive batches, exposing each batch followed by its delay batches as one dispersed batch.
+// Every channel is a ring of nrDelayBatches + 1 batches; the start of the ring is mirrored after its end,
+// so that the dispersed batch is contiguous in each channel whatever batch it starts from.
+// One sample per element (8 bits or more).
+template<typename T> class BatchWindow {
+public:
+  // Padding is in bytes
+  BatchWindow(const Observation & observation, const unsigned int padding, const bool subbanding = false);
+  ~BatchWindow();
+
+  // Add the next batch; its channels are batchChannelStride elements apart (e.g. BatchLayout::getChannelStride())
+  void push(const T * batch, const unsigned int batchChannelStride);
+  // True when the window holds a complete dispersed batch
+  bool isReady() const;
+  // Batch where the current dispersed batch starts
+  unsigned int getBatch() const;
+  unsigned int getNrChannels() const;
+  unsigned int getNrSamplesPerDispersedBatch() const;
+  // Padded distance, in elements, between two channels of the dispersed batch
+  uint64_t getChannelStride() const;
+  // Current dispersed batch: sample s of channel c is at getData()[(c * getChannelStride()) + s]
+  const T * getData() const;
+
+private:
+  unsigned int nrChannels;
+  unsigned int nrSamplesPerBatch;
+  unsigned int nrSamplesPerDispersedBatch;
+  unsigned int nrRingBatches;
+  // Samples at the start of the ring that are also stored after its end
+  unsigned int nrMirroredSamples;
+  uint64_t channelStride;
+  unsigned int nrBatches;
+  std::vector<T> ring;
+};
+
+// Implementations
+template<typename T> BatchWindow<T>::BatchWindow(const Observation & observation, const unsigned int padding, const bool subbanding) : nrBatches(0) {
+  nrChannels = observation.getNrChannels();
+  nrSamplesPerBatch = observation.getNrSamplesPerBatch(subbanding);
+  nrSamplesPerDispersedBatch = observation.getNrSamplesPerDispersedBatch(subbanding);
+  nrRingBatches = observation.getNrDelayBatches(subbanding) + 1;
+  if ( nrSamplesPerBatch == 0 || nrSamplesPerDispersedBatch < nrSamplesPerBatch || nrSamplesPerDispersedBatch > static_cast<uint64_t>(nrRingBatches) * nrSamplesPerBatch ) {
+    throw ObservationError("ERROR: " + std::to_string(nrSamplesPerDispersedBatch) + " samples per dispersed batch do not fit in " + std::to_string(nrRingBatches) + " batches of " + std::to_string(nrSamplesPerBatch) + " samples");
+  }
+  nrMirroredSamples = nrSamplesPerDispersedBatch - nrSamplesPerBatch;
+  channelStride = staticPad((nrRingBatches * nrSamplesPerBatch) + nrMirroredSamples, padding / sizeof(T));
+  ring.resize(nrChannels * channelStride);
+}
+
+template<typename T> BatchWindow<T>::~BatchWindow() {}
+
+template<typename T> void BatchWindow<T>::push(const T * batch, const unsigned int batchChannelStride) {
+  const unsigned int first = (nrBatches % nrRingBatches) * nrSamplesPerBatch;
+  const unsigned int nrRingSamples = nrRingBatches * nrSamplesPerBatch;
+  // Part of this batch that falls in the mirrored start of the ring
+  const unsigned int nrMirrored = (first < nrMirroredSamples) ? std::min(nrSamplesPerBatch, nrMirroredSamples - first) : 0;
+
+  for ( unsigned int channel = 0; channel < nrChannels; channel++ ) {
+    T * channelRing = ring.data() + (channel * channelStride);
+
+    std::memcpy(reinterpret_cast<void *>(channelRing + first), reinterpret_cast<const void *>(batch + (static_cast<uint64_t>(channel) * batchChannelStride)), nrSamplesPerBatch * sizeof(T));
+    if ( nrMirrored > 0 ) {
+      std::memcpy(reinterpret_cast<void *>(channelRing + nrRingSamples + first), reinterpret_cast<const void *>(channelRing + first), nrMirrored * sizeof(T));
+    }
+  }
+  nrBatches++;
+}
+
+template<typename T> inline bool BatchWindow<T>::isReady() const {
+  return nrBatches >= nrRingBatches;
+}
+
+template<typename T> inline unsigned int BatchWindow<T>::getBatch() const {
+  return nrBatches - nrRingBatches;
+}
+
+template<typename T> inline unsigned int BatchWindow<T>::getNrChannels() const {
+  return nrChannels;
+}
+
+template<typename T> inline unsigned int BatchWindow<T>::getNrSamplesPerDispersedBatch() const {
+  return nrSamplesPerDispersedBatch;
+}
+
+template<typename T> inline uint64_t BatchWindow<T>::getChannelStride() const {
+  return channelStride;
+}
+
+template<typename T> inline const T * BatchWindow<T>::getData() const {
+  return ring.data() + ((getBatch() % nrRingBatches) * nrSamplesPerBatch);
+}
+
+} // AstroData
+
@@ -0,0 +1,53 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+#include <set>
+#include <cstdint>
+
+#include "Observation.hpp"
+#include "Platform.hpp"
+
+
+#pragma once
+
+namespace AstroData {
+
+// Configuration files of a run
+struct Configuration {
+  paddingConf padding;
+  vectorWidthConf vectorWidth;
+  // One value per channel, 1 if the channel is zapped
+  std::vector<unsigned int> zappedChannels;
+  std::set<unsigned int> integrationSteps;
+};
+
+// Zapped channels (excluded from computation)
+void readZappedChannels(Observation & observation, const std::string & inputFileName, std::vector<unsigned int> & zappedChannels);
+// Integration steps
+void readIntegrationSteps(const Observation & observation, const std::string  & inputFileName, std::set<unsigned int> & integrationSteps);
+// Parse whitespace separated values, with # comments; malformed and out of range values are reported with their line number
+void parseZappedChannels(const char * text, const uint64_t size, const std::string & filename, const unsigned int nrChannels, std::vector<unsigned int> & zappedChannels, unsigned int & nrZappedChannels);
+void parseIntegrationSteps(const char * text, const uint64_t size, const std::string & filename, const unsigned int nrSamplesPerBatch, std::set<unsigned int> & integrationSteps);
+// Read the four configuration files in parallel, and set the number of zapped channels of the observation; empty file names are not read
+void readConfiguration(Observation & observation, const std::string & paddingFilename, const std::string & vectorFilename, const std::string & zappedChannelsFilename, const std::string & integrationStepsFilename, Configuration & configuration);
+// Binary copy of a parsed configuration, for workers that should not parse the text files again.
+// The blob is only valid for observations with the same channels and samples per batch.
+void writeConfigurationBlob(const Observation & observation, const Configuration & configuration, const std::string & filename);
+void readConfigurationBlob(Observation & observation, const std::string & filename, Configuration & configuration);
+
+} // AstroData
+
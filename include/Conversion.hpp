@@ -0,0 +1,219 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+
+#include "Observation.hpp"
+#include "StaticLayout.hpp"
+#include "BatchLayout.hpp"
+
+
+#pragma once
+
+namespace AstroData {
+
+// Layout to read batches described by inputLayout and store them as described by outputLayout (see readRawBatches)
+template<typename LI, typename LO> class ConversionLayout {
+public:
+  ConversionLayout(const LI & inputLayout, const LO & outputLayout);
+  ~ConversionLayout();
+
+  uint64_t getNrInputBytesPerBatch() const;
+  uint64_t getNrElementsPerBatch() const;
+  uint64_t getNrBytesPerBatch() const;
+
+private:
+  const LI & inputLayout;
+  const LO & outputLayout;
+};
+
+// Convert one batch between layouts with the same channels and samples, e.g. packed 2 bit to float, or float to 8 bit.
+// Every sample becomes (sample * scale[channel]) + offset[channel]; empty scale and offset leave samples unchanged.
+// Integer and packed outputs are rounded and saturated.
+template<typename I, typename O, typename LI, typename LO> void convertBatch(const LI & inputLayout, const I * input, const LO & outputLayout, O * output, const std::vector<float> & scale = std::vector<float>(), const std::vector<float> & offset = std::vector<float>());
+template<typename I, typename O, typename LI, typename LO> void convertBatches(const LI & inputLayout, const std::vector<std::vector<I> *> & input, const LO & outputLayout, std::vector<std::vector<O> *> & output, const std::vector<float> & scale = std::vector<float>(), const std::vector<float> & offset = std::vector<float>());
+// Samples of one channel of a batch, as float
+template<typename I, typename L> inline void loadChannel(const L & layout, const I * input, const unsigned int channel, float * samples);
+// Scale and offset must be empty or have an entry per channel
+inline void checkScaleAndOffset(const unsigned int nrChannels, const std::vector<float> & scale, const std::vector<float> & offset);
+// Apply scale and offset of one channel; sizes are not checked
+inline void scaleChannel(const unsigned int nrSamples, const std::vector<float> & scale, const std::vector<float> & offset, const unsigned int channel, float * samples);
+// Store the float samples of one channel in a batch
+template<typename O, typename L> inline void storeChannel(const L & layout, const float * samples, const unsigned int channel, O * output);
+// Round and saturate to the range of O, NaN is stored as zero (floating point values are stored unchanged)
+template<typename O> inline O quantize(const float value);
+template<> inline float quantize<float>(const float value);
+template<> inline double quantize<double>(const float value);
+// Samples of every byte value, for packed samples of inputBits
+inline const std::vector<float> & getUnpackTable(const uint8_t inputBits);
+
+// Implementations
+
+template<typename LI, typename LO> ConversionLayout<LI, LO>::ConversionLayout(const LI & inputLayout, const LO & outputLayout) : inputLayout(inputLayout), outputLayout(outputLayout) {}
+
+template<typename LI, typename LO> ConversionLayout<LI, LO>::~ConversionLayout() {}
+
+template<typename LI, typename LO> inline uint64_t ConversionLayout<LI, LO>::getNrInputBytesPerBatch() const {
+  return inputLayout.getNrInputBytesPerBatch();
+}
+
+template<typename LI, typename LO> inline uint64_t ConversionLayout<LI, LO>::getNrElementsPerBatch() const {
+  return outputLayout.getNrElementsPerBatch();
+}
+
+template<typename LI, typename LO> inline uint64_t ConversionLayout<LI, LO>::getNrBytesPerBatch() const {
+  return outputLayout.getNrBytesPerBatch();
+}
+
+template<typename I, typename O, typename LI, typename LO> void convertBatch(const LI & inputLayout, const I * input, const LO & outputLayout, O * output, const std::vector<float> & scale, const std::vector<float> & offset) {
+  if ( inputLayout.getNrChannels() != outputLayout.getNrChannels() || inputLayout.getNrSamplesPerBatch() != outputLayout.getNrSamplesPerBatch() ) {
+    throw ObservationError("ERROR: impossible to convert between batches of different shape");
+  }
+  checkScaleAndOffset(inputLayout.getNrChannels(), scale, offset);
+  #pragma omp parallel
+  {
+    // One channel at a time, so the intermediate samples stay in cache
+    std::vector<float> samples(inputLayout.getNrSamplesPerBatch());
+
+    #pragma omp for schedule(static)
+    for ( unsigned int channel = 0; channel < inputLayout.getNrChannels(); channel++ ) {
+      loadChannel(inputLayout, input, channel, samples.data());
+      scaleChannel(inputLayout.getNrSamplesPerBatch(), scale, offset, channel, samples.data());
+      storeChannel(outputLayout, samples.data(), channel, output);
+    }
+  }
+}
+
+template<typename I, typename O, typename LI, typename LO> void convertBatches(const LI & inputLayout, const std::vector<std::vector<I> *> & input, const LO & outputLayout, std::vector<std::vector<O> *> & output, const std::vector<float> & scale, const std::vector<float> & offset) {
+  output.resize(input.size());
+  for ( unsigned int batch = 0; batch < input.size(); batch++ ) {
+    output.at(batch) = new std::vector<O>(outputLayout.getNrElementsPerBatch());
+    convertBatch(inputLayout, input.at(batch)->data(), outputLayout, output.at(batch)->data(), scale, offset);
+  }
+}
+
+template<typename I, typename L> inline void loadChannel(const L & layout, const I * input, const unsigned int channel, float * samples) {
+  const I * channelInput = input + layout.getIndex(channel, 0);
+
+  if ( layout.getNrInputBits() >= 8 ) {
+    #pragma omp simd
+    for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
+      samples[sample] = static_cast<float>(channelInput[sample]);
+    }
+  } else {
+    const std::vector<float> & table = getUnpackTable(layout.getNrInputBits());
+    const unsigned int samplesPerElement = layout.getNrSamplesPerElement();
+
+    for ( unsigned int element = 0; element < layout.getNrElementsPerChannel(); element++ ) {
+      const float * elementSamples = table.data() + (static_cast<uint8_t>(channelInput[element]) * samplesPerElement);
+
+      for ( unsigned int item = 0; item < samplesPerElement; item++ ) {
+        samples[(element * samplesPerElement) + item] = elementSamples[item];
+      }
+    }
+  }
+}
+
+inline void checkScaleAndOffset(const unsigned int nrChannels, const std::vector<float> & scale, const std::vector<float> & offset) {
+  if ( (!scale.empty() && scale.size() < nrChannels) || (!offset.empty() && offset.size() < nrChannels) ) {
+    throw ObservationError("ERROR: scale and offset need " + std::to_string(nrChannels) + " channels");
+  }
+}
+
+inline void scaleChannel(const unsigned int nrSamples, const std::vector<float> & scale, const std::vector<float> & offset, const unsigned int channel, float * samples) {
+  const float channelScale = scale.empty() ? 1.0f : scale[channel];
+  const float channelOffset = offset.empty() ? 0.0f : offset[channel];
+
+  if ( scale.empty() && offset.empty() ) {
+    return;
+  }
+  #pragma omp simd
+  for ( unsigned int sample = 0; sample < nrSamples; sample++ ) {
+    samples[sample] = (samples[sample] * channelScale) + channelOffset;
+  }
+}
+
+template<typename O, typename L> inline void storeChannel(const L & layout, const float * samples, const unsigned int channel, O * output) {
+  O * channelOutput = output + layout.getIndex(channel, 0);
+
+  if ( layout.getNrInputBits() >= 8 ) {
+    #pragma omp simd
+    for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
+      channelOutput[sample] = quantize<O>(samples[sample]);
+    }
+  } else {
+    const uint8_t inputBits = layout.getNrInputBits();
+    const float maximum = static_cast<float>((1 << inputBits) - 1);
+    const unsigned int samplesPerElement = layout.getNrSamplesPerElement();
+
+    for ( unsigned int element = 0; element < layout.getNrElementsPerChannel(); element++ ) {
+      uint8_t packed = 0;
+
+      for ( unsigned int item = 0; item < samplesPerElement; item++ ) {
+        const float sample = samples[(element * samplesPerElement) + item];
+        const float value = std::isnan(sample) ? 0.0f : std::min(std::max(std::nearbyint(sample), 0.0f), maximum);
+
+        packed |= static_cast<uint8_t>(value) << (item * inputBits);
+      }
+      channelOutput[element] = static_cast<O>(packed);
+    }
+  }
+}
+
+template<typename O> inline O quantize(const float value) {
+  if ( std::isnan(value) ) {
+    return 0;
+  }
+  const double rounded = std::nearbyint(static_cast<double>(value));
+
+  return static_cast<O>(std::min(std::max(rounded, static_cast<double>(std::numeric_limits<O>::lowest())), static_cast<double>(std::numeric_limits<O>::max())));
+}
+
+template<> inline float quantize<float>(const float value) {
+  return value;
+}
+
+template<> inline double quantize<double>(const float value) {
+  return value;
+}
+
+inline const std::vector<float> & getUnpackTable(const uint8_t inputBits) {
+  static const std::vector<std::vector<float>> tables = []() {
+    std::vector<std::vector<float>> tables(8);
+
+    for ( uint8_t bits = 1; bits < 8; bits *= 2 ) {
+      const unsigned int samplesPerByte = 8 / bits;
+      const uint8_t mask = static_cast<uint8_t>((1 << bits) - 1);
+
+      tables.at(bits).resize(256 * samplesPerByte);
+      for ( unsigned int byte = 0; byte < 256; byte++ ) {
+        for ( unsigned int item = 0; item < samplesPerByte; item++ ) {
+          tables.at(bits).at((byte * samplesPerByte) + item) = static_cast<float>((byte >> (item * bits)) & mask);
+        }
+      }
+    }
+    return tables;
+  }();
+
+  return tables.at(inputBits);
+}
+
+} // AstroData
+
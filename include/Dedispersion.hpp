@@ -0,0 +1,255 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "Observation.hpp"
+#include "StaticLayout.hpp"
+#include "Conversion.hpp"
+
+
+#pragma once
+
+namespace AstroData {
+
+// Tiles of the dedispersion loops: the accumulators of a tile (DMs x samples floats) stay in cache while
+// the channels of a tile, shifted for each of its DMs, are read from L2
+struct DedispersionTiling {
+  unsigned int nrDMs;
+  unsigned int nrChannels;
+  unsigned int nrSamples;
+};
+
+// Brute-force dedispersion on the CPU, of one dispersed batch (e.g. from BatchWindow) into one batch per DM.
+// Without subbanding, every channel is delayed to the highest frequency for the getNrDMs() DMs, reading getNrSamplesPerDispersedBatch() samples per channel.
+// With subbanding, the first step dedisperses the channels of each subband to its highest channel for the getNrDMs(true) DMs,
+// reading getNrSamplesPerDispersedBatch(true) and producing getNrSamplesPerBatch(true) samples per subband;
+// the second step delays the subbands for the getNrDMs() DMs around each of them, giving getNrDMs(true) * getNrDMs() series.
+// Output is [DM][sample], padded; one sample per input element (8 bits or more).
+template<typename I, typename O> class Dedispersion {
+public:
+  // Padding is in bytes; zapped channels, as filled by readZappedChannels, are skipped
+  Dedispersion(const Observation & observation, const unsigned int padding, const bool subbanding = false, const std::vector<unsigned int> & zappedChannels = std::vector<unsigned int>(), const DedispersionTiling & tiling = DedispersionTiling{8, 32, 1024});
+  ~Dedispersion();
+
+  // Channels of the input are inputChannelStride elements apart (e.g. BatchWindow::getChannelStride())
+  void dedisperse(const I * input, const uint64_t inputChannelStride, O * output);
+  unsigned int getNrDMs() const;
+  unsigned int getNrSamplesPerBatch() const;
+  // Padded distance, in elements, between two DMs of the output
+  unsigned int getSampleStride() const;
+  uint64_t getNrElementsPerBatch() const;
+  uint64_t getIndex(const unsigned int dm, const unsigned int sample) const;
+  // Delay in samples of a channel for a DM; without subbanding only
+  unsigned int getShift(const unsigned int dm, const unsigned int channel) const;
+
+private:
+  // Dedisperse rows of nrGroups groups: output row (group, dm) is the sum of the rows of the group, each shifted by shifts[group][dm][row]
+  template<typename IN, typename OUT> void dedisperseGroups(const IN * input, const uint64_t groupStride, const uint64_t rowStride, const unsigned int nrGroups, const unsigned int nrRows, const unsigned int nrGroupDMs, const unsigned int nrOutputSamples, const std::vector<unsigned int> & groupShifts, const std::vector<uint8_t> & rowZapped, OUT * output, const uint64_t outputStride) const;
+  // Delay in samples of frequency, relative to referenceFrequency
+  unsigned int getDelay(const float DM, const double frequency, const double referenceFrequency) const;
+
+  bool subbanding;
+  DedispersionTiling tiling;
+  double samplingTime;
+  unsigned int nrChannels;
+  unsigned int nrSubbands;
+  unsigned int nrChannelsPerSubband;
+  unsigned int nrSubbandingDMs;
+  unsigned int nrDMs;
+  unsigned int nrSamplesPerBatch;
+  unsigned int nrSamplesPerSubbandingBatch;
+  unsigned int sampleStride;
+  unsigned int subbandStride;
+  // [DM][channel], or [subband][subbanding DM][channel] for the first step
+  std::vector<unsigned int> shifts;
+  // [subbanding DM][DM][subband]
+  std::vector<unsigned int> subbandShifts;
+  std::vector<uint8_t> zapped;
+  std::vector<uint8_t> subbandZapped;
+  // Output of the first step, [subband][subbanding DM][sample]
+  std::vector<float> subbands;
+};
+
+// Implementations
+
+template<typename I, typename O> Dedispersion<I, O>::Dedispersion(const Observation & observation, const unsigned int padding, const bool subbanding, const std::vector<unsigned int> & zappedChannels, const DedispersionTiling & tiling) : subbanding(subbanding), tiling(tiling) {
+  const float firstDM = observation.getFirstDM();
+  const float DMStep = observation.getDMStep();
+  unsigned int maxShift = 0;
+
+  samplingTime = observation.getSamplingTime();
+  nrChannels = observation.getNrChannels();
+  nrSubbands = subbanding ? observation.getNrSubbands() : 1;
+  nrChannelsPerSubband = subbanding ? observation.getNrChannelsPerSubband() : nrChannels;
+  nrSubbandingDMs = subbanding ? observation.getNrDMs(true) : 1;
+  nrDMs = observation.getNrDMs();
+  nrSamplesPerBatch = observation.getNrSamplesPerBatch();
+  nrSamplesPerSubbandingBatch = observation.getNrSamplesPerBatch(true);
+  sampleStride = staticPad(nrSamplesPerBatch, padding / sizeof(O));
+  if ( samplingTime <= 0.0 || nrDMs == 0 || nrSubbandingDMs == 0 || this->tiling.nrDMs == 0 || this->tiling.nrChannels == 0 || this->tiling.nrSamples == 0 ) {
+    throw ObservationError("ERROR: dedispersion needs the sampling time, DMs and non-empty tiles");
+  }
+  zapped.assign(nrChannels, 0);
+  for ( unsigned int channel = 0; channel < std::min(nrChannels, static_cast<unsigned int>(zappedChannels.size())); channel++ ) {
+    zapped.at(channel) = zappedChannels.at(channel) != 0;
+  }
+  if ( !subbanding ) {
+    shifts.resize(static_cast<uint64_t>(nrDMs) * nrChannels);
+    for ( unsigned int dm = 0; dm < nrDMs; dm++ ) {
+      for ( unsigned int channel = 0; channel < nrChannels; channel++ ) {
+        shifts.at((static_cast<uint64_t>(dm) * nrChannels) + channel) = getDelay(firstDM + (dm * DMStep), observation.getMinFreq() + (channel * observation.getChannelBandwidth()), observation.getMaxFreq());
+        maxShift = std::max(maxShift, shifts.at((static_cast<uint64_t>(dm) * nrChannels) + channel));
+      }
+    }
+    if ( nrSamplesPerBatch + maxShift > observation.getNrSamplesPerDispersedBatch() ) {
+      throw ObservationError("ERROR: the dispersed batch is " + std::to_string(observation.getNrSamplesPerDispersedBatch()) + " samples, dedispersion needs " + std::to_string(nrSamplesPerBatch + maxShift));
+    }
+  } else {
+    const float firstSubbandingDM = observation.getFirstDM(true);
+    const float subbandingDMStep = observation.getDMStep(true);
+    unsigned int maxSubbandShift = 0;
+
+    subbandStride = staticPad(nrSamplesPerSubbandingBatch, padding / sizeof(float));
+    shifts.resize(static_cast<uint64_t>(nrSubbands) * nrSubbandingDMs * nrChannelsPerSubband);
+    subbandShifts.resize(static_cast<uint64_t>(nrSubbandingDMs) * nrDMs * nrSubbands);
+    for ( unsigned int subband = 0; subband < nrSubbands; subband++ ) {
+      // Highest channel of the subband
+      const double subbandFrequency = observation.getMinFreq() + ((((subband + 1) * nrChannelsPerSubband) - 1) * observation.getChannelBandwidth());
+
+      for ( unsigned int subbandingDM = 0; subbandingDM < nrSubbandingDMs; subbandingDM++ ) {
+        for ( unsigned int channel = 0; channel < nrChannelsPerSubband; channel++ ) {
+          const uint64_t item = (((static_cast<uint64_t>(subband) * nrSubbandingDMs) + subbandingDM) * nrChannelsPerSubband) + channel;
+
+          shifts.at(item) = getDelay(firstSubbandingDM + (subbandingDM * subbandingDMStep), observation.getMinFreq() + (((subband * nrChannelsPerSubband) + channel) * observation.getChannelBandwidth()), subbandFrequency);
+          maxShift = std::max(maxShift, shifts.at(item));
+        }
+        for ( unsigned int dm = 0; dm < nrDMs; dm++ ) {
+          const uint64_t item = (((static_cast<uint64_t>(subbandingDM) * nrDMs) + dm) * nrSubbands) + subband;
+
+          subbandShifts.at(item) = getDelay(firstSubbandingDM + (subbandingDM * subbandingDMStep) + firstDM + (dm * DMStep), subbandFrequency, observation.getMaxFreq());
+          maxSubbandShift = std::max(maxSubbandShift, subbandShifts.at(item));
+        }
+      }
+    }
+    if ( nrSamplesPerSubbandingBatch + maxShift > observation.getNrSamplesPerDispersedBatch(true) || nrSamplesPerBatch + maxSubbandShift > nrSamplesPerSubbandingBatch ) {
+      throw ObservationError("ERROR: the subbanding batches are too short for the DMs of the observation");
+    }
+    // Every subbanding DM is a group of the second step
+    subbandZapped.assign(static_cast<uint64_t>(nrSubbandingDMs) * nrSubbands, 0);
+    subbands.resize(static_cast<uint64_t>(nrSubbands) * nrSubbandingDMs * subbandStride);
+  }
+}
+
+template<typename I, typename O> Dedispersion<I, O>::~Dedispersion() {}
+
+template<typename I, typename O> void Dedispersion<I, O>::dedisperse(const I * input, const uint64_t inputChannelStride, O * output) {
+  if ( !subbanding ) {
+    dedisperseGroups(input, 0, inputChannelStride, 1, nrChannels, nrDMs, nrSamplesPerBatch, shifts, zapped, output, sampleStride);
+  } else {
+    // Subbands are the groups of the first step, subbanding DMs those of the second
+    dedisperseGroups(input, nrChannelsPerSubband * inputChannelStride, inputChannelStride, nrSubbands, nrChannelsPerSubband, nrSubbandingDMs, nrSamplesPerSubbandingBatch, shifts, zapped, subbands.data(), subbandStride);
+    dedisperseGroups(subbands.data(), subbandStride, static_cast<uint64_t>(nrSubbandingDMs) * subbandStride, nrSubbandingDMs, nrSubbands, nrDMs, nrSamplesPerBatch, subbandShifts, subbandZapped, output, sampleStride);
+  }
+}
+
+template<typename I, typename O> template<typename IN, typename OUT> void Dedispersion<I, O>::dedisperseGroups(const IN * input, const uint64_t groupStride, const uint64_t rowStride, const unsigned int nrGroups, const unsigned int nrRows, const unsigned int nrGroupDMs, const unsigned int nrOutputSamples, const std::vector<unsigned int> & groupShifts, const std::vector<uint8_t> & rowZapped, OUT * output, const uint64_t outputStride) const {
+  const unsigned int nrDMTiles = (nrGroupDMs + tiling.nrDMs - 1) / tiling.nrDMs;
+  const unsigned int nrSampleTiles = (nrOutputSamples + tiling.nrSamples - 1) / tiling.nrSamples;
+
+  #pragma omp parallel
+  {
+    std::vector<float> accumulators(static_cast<uint64_t>(tiling.nrDMs) * tiling.nrSamples);
+
+    #pragma omp for collapse(3) schedule(static)
+    for ( unsigned int group = 0; group < nrGroups; group++ ) {
+      for ( unsigned int dmTile = 0; dmTile < nrDMTiles; dmTile++ ) {
+        for ( unsigned int sampleTile = 0; sampleTile < nrSampleTiles; sampleTile++ ) {
+          const unsigned int firstDM = dmTile * tiling.nrDMs;
+          const unsigned int lastDM = std::min(firstDM + tiling.nrDMs, nrGroupDMs);
+          const unsigned int firstSample = sampleTile * tiling.nrSamples;
+          const unsigned int nrTileSamples = std::min(tiling.nrSamples, nrOutputSamples - firstSample);
+          // In the group (e.g. a subband), the rows are consecutive in rowZapped
+          const uint8_t * groupZapped = rowZapped.data() + (static_cast<uint64_t>(group) * nrRows);
+
+          std::fill(accumulators.begin(), accumulators.end(), 0.0f);
+          for ( unsigned int firstRow = 0; firstRow < nrRows; firstRow += tiling.nrChannels ) {
+            const unsigned int lastRow = std::min(firstRow + tiling.nrChannels, nrRows);
+
+            for ( unsigned int dm = firstDM; dm < lastDM; dm++ ) {
+              float * accumulator = accumulators.data() + (static_cast<uint64_t>(dm - firstDM) * tiling.nrSamples);
+              const unsigned int * rowShifts = groupShifts.data() + (((static_cast<uint64_t>(group) * nrGroupDMs) + dm) * nrRows);
+
+              for ( unsigned int row = firstRow; row < lastRow; row++ ) {
+                if ( groupZapped[row] ) {
+                  continue;
+                }
+                const IN * samples = input + (group * groupStride) + (row * rowStride) + firstSample + rowShifts[row];
+
+                #pragma omp simd
+                for ( unsigned int sample = 0; sample < nrTileSamples; sample++ ) {
+                  accumulator[sample] += static_cast<float>(samples[sample]);
+                }
+              }
+            }
+          }
+          for ( unsigned int dm = firstDM; dm < lastDM; dm++ ) {
+            const float * accumulator = accumulators.data() + (static_cast<uint64_t>(dm - firstDM) * tiling.nrSamples);
+            OUT * dmOutput = output + ((((static_cast<uint64_t>(group) * nrGroupDMs) + dm)) * outputStride) + firstSample;
+
+            #pragma omp simd
+            for ( unsigned int sample = 0; sample < nrTileSamples; sample++ ) {
+              dmOutput[sample] = quantize<OUT>(accumulator[sample]);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template<typename I, typename O> inline unsigned int Dedispersion<I, O>::getDelay(const float DM, const double frequency, const double referenceFrequency) const {
+  return static_cast<unsigned int>(std::nearbyint((4148.808 * DM * ((1.0 / (frequency * frequency)) - (1.0 / (referenceFrequency * referenceFrequency)))) / samplingTime));
+}
+
+template<typename I, typename O> inline unsigned int Dedispersion<I, O>::getNrDMs() const {
+  return nrSubbandingDMs * nrDMs;
+}
+
+template<typename I, typename O> inline unsigned int Dedispersion<I, O>::getNrSamplesPerBatch() const {
+  return nrSamplesPerBatch;
+}
+
+template<typename I, typename O> inline unsigned int Dedispersion<I, O>::getSampleStride() const {
+  return sampleStride;
+}
+
+template<typename I, typename O> inline uint64_t Dedispersion<I, O>::getNrElementsPerBatch() const {
+  return static_cast<uint64_t>(getNrDMs()) * sampleStride;
+}
+
+template<typename I, typename O> inline uint64_t Dedispersion<I, O>::getIndex(const unsigned int dm, const unsigned int sample) const {
+  return (static_cast<uint64_t>(dm) * sampleStride) + sample;
+}
+
+template<typename I, typename O> inline unsigned int Dedispersion<I, O>::getShift(const unsigned int dm, const unsigned int channel) const {
+  return shifts.at((static_cast<uint64_t>(dm) * nrChannels) + channel);
+}
+
+} // AstroData
+
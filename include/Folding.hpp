@@ -0,0 +1,191 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "Observation.hpp"
+#include "StaticLayout.hpp"
+#include "Dedispersion.hpp"
+
+
+#pragma once
+
+namespace AstroData {
+
+// Epoch folding of dedispersed time series, one batch at a time, for every trial period of the observation.
+// Periods are in samples; sample s of the stream goes in bin ((s % period) * nrBins) / period.
+// Samples of a bin are consecutive in time, so every bin of a batch is one vectorized sum; periods and DMs are folded in parallel.
+template<typename T> class Folding {
+public:
+  // Padding is in bytes; with subbanding the getNrDMs(true) * getNrDMs() series of two-step dedispersion are folded.
+  // Series have getNrSamplesPerBatch() samples, with or without subbanding.
+  Folding(const Observation & observation, const unsigned int padding, const bool subbanding = false);
+  ~Folding();
+
+  // Fold the next batch; the series of a DM are getSampleStride() elements apart
+  void fold(const T * dedispersed);
+  // Throw if the output of dedispersion does not have the layout of the input
+  template<typename I> void checkInput(const Dedispersion<I, T> & dedispersion) const;
+  // Start a new stream
+  void reset();
+  // Samples folded so far
+  uint64_t getNrSamples() const;
+  unsigned int getNrDMs() const;
+  // Padded distance, in elements, between the series of two DMs in the input
+  unsigned int getSampleStride() const;
+  // Padded number of bins of a profile
+  unsigned int getBinStride() const;
+  // Sum of the samples in every bin, [DM][period][bin]
+  const std::vector<float> & getProfiles() const;
+  // Samples in every bin, the same for all DMs, [period][bin]
+  const std::vector<unsigned int> & getCounters() const;
+  uint64_t getIndex(const unsigned int dm, const unsigned int period, const unsigned int bin) const;
+  // Average of the samples in a bin
+  float getMean(const unsigned int dm, const unsigned int period, const unsigned int bin) const;
+
+private:
+  unsigned int nrDMs;
+  unsigned int nrSamplesPerBatch;
+  unsigned int sampleStride;
+  unsigned int nrPeriods;
+  unsigned int firstPeriod;
+  unsigned int periodStep;
+  unsigned int nrBins;
+  unsigned int binStride;
+  uint64_t nrSamples;
+  std::vector<float> profiles;
+  std::vector<unsigned int> counters;
+};
+
+// Implementations
+
+template<typename T> Folding<T>::Folding(const Observation & observation, const unsigned int padding, const bool subbanding) : nrSamples(0) {
+  nrDMs = subbanding ? observation.getNrDMs(true) * observation.getNrDMs() : observation.getNrDMs();
+  nrSamplesPerBatch = observation.getNrSamplesPerBatch();
+  sampleStride = staticPad(nrSamplesPerBatch, padding / sizeof(T));
+  nrPeriods = observation.getNrPeriods();
+  firstPeriod = observation.getFirstPeriod();
+  periodStep = observation.getPeriodStep();
+  nrBins = observation.getNrBins();
+  binStride = staticPad(nrBins, padding / sizeof(float));
+  if ( nrPeriods == 0 || firstPeriod == 0 || nrBins == 0 ) {
+    throw ObservationError("ERROR: folding needs periods of at least one sample and at least one bin");
+  }
+  profiles.resize(static_cast<uint64_t>(nrDMs) * nrPeriods * binStride);
+  counters.resize(static_cast<uint64_t>(nrPeriods) * binStride);
+}
+
+template<typename T> Folding<T>::~Folding() {}
+
+template<typename T> void Folding<T>::fold(const T * dedispersed) {
+  #pragma omp parallel
+  {
+    #pragma omp for collapse(2) schedule(static) nowait
+    for ( unsigned int period = 0; period < nrPeriods; period++ ) {
+      for ( unsigned int dm = 0; dm < nrDMs; dm++ ) {
+        const uint64_t periodSamples = firstPeriod + (static_cast<uint64_t>(period) * periodStep);
+        const T * series = dedispersed + (static_cast<uint64_t>(dm) * sampleStride);
+        float * profile = profiles.data() + getIndex(dm, period, 0);
+        uint64_t phase = nrSamples % periodSamples;
+        unsigned int sample = 0;
+
+        while ( sample < nrSamplesPerBatch ) {
+          const unsigned int bin = (phase * nrBins) / periodSamples;
+          // First phase of the next bin
+          const uint64_t nextPhase = (((bin + 1) * periodSamples) + nrBins - 1) / nrBins;
+          const unsigned int end = static_cast<unsigned int>(std::min(static_cast<uint64_t>(nrSamplesPerBatch), sample + (nextPhase - phase)));
+          float sum = 0.0f;
+
+          #pragma omp simd reduction(+:sum)
+          for ( unsigned int item = sample; item < end; item++ ) {
+            sum += static_cast<float>(series[item]);
+          }
+          profile[bin] += sum;
+          phase = (phase + (end - sample)) % periodSamples;
+          sample = end;
+        }
+      }
+    }
+    #pragma omp for schedule(static)
+    for ( unsigned int period = 0; period < nrPeriods; period++ ) {
+      const uint64_t periodSamples = firstPeriod + (static_cast<uint64_t>(period) * periodStep);
+      unsigned int * counter = counters.data() + (static_cast<uint64_t>(period) * binStride);
+      uint64_t phase = nrSamples % periodSamples;
+      unsigned int sample = 0;
+
+      while ( sample < nrSamplesPerBatch ) {
+        const unsigned int bin = (phase * nrBins) / periodSamples;
+        const uint64_t nextPhase = (((bin + 1) * periodSamples) + nrBins - 1) / nrBins;
+        const unsigned int end = static_cast<unsigned int>(std::min(static_cast<uint64_t>(nrSamplesPerBatch), sample + (nextPhase - phase)));
+
+        counter[bin] += end - sample;
+        phase = (phase + (end - sample)) % periodSamples;
+        sample = end;
+      }
+    }
+  }
+  nrSamples += nrSamplesPerBatch;
+}
+
+template<typename T> template<typename I> void Folding<T>::checkInput(const Dedispersion<I, T> & dedispersion) const {
+  if ( dedispersion.getNrDMs() != nrDMs || dedispersion.getNrSamplesPerBatch() != nrSamplesPerBatch || dedispersion.getSampleStride() != sampleStride ) {
+    throw ObservationError("ERROR: the dedispersed batches do not have the layout expected by folding");
+  }
+}
+
+template<typename T> void Folding<T>::reset() {
+  std::fill(profiles.begin(), profiles.end(), 0.0f);
+  std::fill(counters.begin(), counters.end(), 0);
+  nrSamples = 0;
+}
+
+template<typename T> inline uint64_t Folding<T>::getNrSamples() const {
+  return nrSamples;
+}
+
+template<typename T> inline unsigned int Folding<T>::getNrDMs() const {
+  return nrDMs;
+}
+
+template<typename T> inline unsigned int Folding<T>::getSampleStride() const {
+  return sampleStride;
+}
+
+template<typename T> inline unsigned int Folding<T>::getBinStride() const {
+  return binStride;
+}
+
+template<typename T> inline const std::vector<float> & Folding<T>::getProfiles() const {
+  return profiles;
+}
+
+template<typename T> inline const std::vector<unsigned int> & Folding<T>::getCounters() const {
+  return counters;
+}
+
+template<typename T> inline uint64_t Folding<T>::getIndex(const unsigned int dm, const unsigned int period, const unsigned int bin) const {
+  return (((static_cast<uint64_t>(dm) * nrPeriods) + period) * binStride) + bin;
+}
+
+template<typename T> inline float Folding<T>::getMean(const unsigned int dm, const unsigned int period, const unsigned int bin) const {
+  const unsigned int counter = counters.at((static_cast<uint64_t>(period) * binStride) + bin);
+
+  return (counter == 0) ? 0.0f : profiles.at(getIndex(dm, period, bin)) / counter;
+}
+
+} // AstroData
+
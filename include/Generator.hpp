@@ -20,6 +20,8 @@
 #include <algorithm>
 
 #include "Observation.hpp"
+#include "StaticLayout.hpp"
+#include "BatchLayout.hpp"
 
 
 #pragma once
@@ -28,17 +30,32 @@ namespace AstroData {
 
 template< typename T > void generatePulsar(const unsigned int period, const unsigned int width, const float DM, const AstroData::Observation & observation, const unsigned int padding, std::vector< std::vector< T > * > & data, const bool random = false);
 template< typename T > void generateSinglePulse(const unsigned int width, const float DM, const AstroData::Observation & observation, const unsigned int padding, std::vector< std::vector< T > * > & data, const uint8_t inputBits, const bool random = false);
+// Generators with a batch layout (e.g. StaticLayout)
+template< typename T, typename L > void generatePulsar(const L & layout, const unsigned int period, const unsigned int width, const float DM, const AstroData::Observation & observation, std::vector< std::vector< T > * > & data, const bool random = false);
+template< typename T, typename L > void generateSinglePulse(const L & layout, const unsigned int width, const float DM, const AstroData::Observation & observation, std::vector< std::vector< T > * > & data, const bool random = false);
+// Store a sub-byte sample in a packed element
+template< typename T > inline void setPackedSample(T & element, const uint8_t value, const uint8_t firstBit, const uint8_t inputBits);
 
 // Implementations
 template< typename T > void generatePulsar(const unsigned int period, const unsigned int width, const float DM, const AstroData::Observation & observation, const unsigned int padding, std::vector< std::vector< T > * > & data, const bool random) {
+  generatePulsar(BatchLayout< T >(observation, padding), period, width, DM, observation, data, random);
+}
+
+template< typename T > void generateSinglePulse(const unsigned int width, const float DM, const AstroData::Observation & observation, const unsigned int padding, std::vector< std::vector< T > * > & data, const uint8_t inputBits, const bool random) {
+  generateSinglePulse(BatchLayout< T >(observation, padding, inputBits), width, DM, observation, data, random);
+}
+
+template< typename T, typename L > void generatePulsar(const L & layout, const unsigned int period, const unsigned int width, const float DM, const AstroData::Observation & observation, std::vector< std::vector< T > * > & data, const bool random) {
+  const uint64_t nrSamples = static_cast< uint64_t >(observation.getNrBatches()) * layout.getNrSamplesPerBatch();
+
   std::srand(std::time(0));
   // Generate the  "noise"
   for ( unsigned int batch = 0; batch < observation.getNrBatches(); batch++ ) {
-    data[batch] = new std::vector< T >(observation.getNrChannels() * observation.getNrSamplesPerBatch(false, padding / sizeof(T)));
+    data[batch] = new std::vector< T >(layout.getNrElementsPerBatch());
     if ( random ) {
-      for ( unsigned int channel = 0; channel < observation.getNrChannels(); channel++ ) {
-        for ( unsigned int sample = 0; sample < observation.getNrSamplesPerBatch(); sample++ ) {
-          data[batch]->at((channel * observation.getNrSamplesPerBatch(false, padding / sizeof(T))) + sample) = static_cast< T >(std::rand() % 25);
+      for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
+        for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
+          data[batch]->at(layout.getIndex(channel, sample)) = static_cast< T >(std::rand() % 25);
         }
       }
     } else {
@@ -48,53 +65,44 @@ template< typename T > void generatePulsar(const unsigned int period, const unsi
   // Generate the pulsar
   float inverseHighFreq = 1.0f / (observation.getMaxFreq() * observation.getMaxFreq());
   float kDM = 4148.808f * DM;
-  for ( unsigned int channel = 0; channel < observation.getNrChannels(); channel++ ) {
+  for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
     float inverseFreq = 1.0f / ((observation.getMinFreq() + (channel * observation.getChannelBandwidth())) * (observation.getMinFreq() + (channel * observation.getChannelBandwidth())));
     float delta = kDM * (inverseFreq - inverseHighFreq);
-    unsigned int shift = static_cast< unsigned int >(delta * observation.getNrSamplesPerBatch());
+    unsigned int shift = static_cast< unsigned int >(delta * layout.getNrSamplesPerBatch());
 
-    for ( unsigned int sample = shift; sample < observation.getNrBatches() * observation.getNrSamplesPerBatch(); sample += period ) {
-      for ( unsigned int i = 0; i < width; i++ ) {
-        if ( sample + i >= observation.getNrBatches() * observation.getNrSamplesPerBatch() ) {
-        break;
-        }
-        unsigned int batch = (sample + i) / observation.getNrSamplesPerBatch();
-        unsigned int internalSample = (sample + i) % observation.getNrSamplesPerBatch();
+    for ( uint64_t sample = shift; sample < nrSamples; sample += period ) {
+      for ( unsigned int i = 0; i < width && sample + i < nrSamples; i++ ) {
+        unsigned int batch = (sample + i) / layout.getNrSamplesPerBatch();
+        unsigned int internalSample = (sample + i) % layout.getNrSamplesPerBatch();
 
         if ( random ) {
-          data[batch]->at((channel * observation.getNrSamplesPerBatch(false, padding / sizeof(T))) + internalSample) = static_cast< T >(std::rand() % 128);
+          data[batch]->at(layout.getIndex(channel, internalSample)) = static_cast< T >(std::rand() % 128);
         } else {
-          data[batch]->at((channel * observation.getNrSamplesPerBatch(false, padding / sizeof(T))) + internalSample) = static_cast< T >(42);
+          data[batch]->at(layout.getIndex(channel, internalSample)) = static_cast< T >(42);
         }
       }
     }
   }
 }
 
-template< typename T > void generateSinglePulse(const unsigned int width, const float DM, const AstroData::Observation & observation, const unsigned int padding, std::vector< std::vector< T > * > & data, const uint8_t inputBits, const bool random) {
+template< typename T, typename L > void generateSinglePulse(const L & layout, const unsigned int width, const float DM, const AstroData::Observation & observation, std::vector< std::vector< T > * > & data, const bool random) {
+  const uint8_t inputBits = layout.getNrInputBits();
+
   std::srand(std::time(0));
   // Generate the  "noise"
   for ( unsigned int batch = 0; batch < observation.getNrBatches(); batch++ ) {
-    if ( inputBits >= 8 ) {
-      data[batch] = new std::vector< T >(observation.getNrChannels() * observation.getNrSamplesPerBatch(false, padding / sizeof(T)));
-    } else {
-      data[batch] = new std::vector< T >(observation.getNrChannels() * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T)));
-    }
+    data[batch] = new std::vector< T >(layout.getNrElementsPerBatch());
     if ( random ) {
-      for ( unsigned int channel = 0; channel < observation.getNrChannels(); channel++ ) {
-        for ( unsigned int sample = 0; sample < observation.getNrSamplesPerBatch(); sample++ ) {
+      for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
+        for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
           if ( inputBits >= 8 ) {
-            data[batch]->at((channel * observation.getNrSamplesPerBatch(false, padding / sizeof(T))) + sample) = static_cast< T >(std::rand() % 25);
+            data[batch]->at(layout.getIndex(channel, sample)) = static_cast< T >(std::rand() % 25);
           } else {
-            unsigned int byte = sample / (8 / inputBits);
-            uint8_t firstBit = (sample % (8 / inputBits)) * inputBits;
-            uint8_t value = static_cast< unsigned int >(std::rand() % (inputBits - 1));
-            unsigned char buffer = data[batch]->at((channel * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T))) + byte);
-
-            for ( uint8_t bit = 0; bit < inputBits; bit++ ) {
-              isa::utils::setBit(buffer, isa::utils::getBit(value, bit), firstBit + bit);
-            }
-            data[batch]->at((channel * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T))) + byte) = buffer;
+            T & element = data[batch]->at(layout.getIndex(channel, sample / layout.getNrSamplesPerElement()));
+
+            uint8_t value = (inputBits > 1) ? static_cast< uint8_t >(std::rand() % (inputBits - 1)) : 0;
+
+            setPackedSample(element, value, (sample % layout.getNrSamplesPerElement()) * inputBits, inputBits);
           }
         }
       }
@@ -114,54 +122,47 @@ template< typename T > void generateSinglePulse(const unsigned int width, const
 
   if ( random ) {
     batch = std::rand() % (observation.getNrBatches() / 2);
-    sample = std::rand() % (observation.getNrSamplesPerBatch() - width);
+    sample = std::rand() % (layout.getNrSamplesPerBatch() - width);
   } else {
     batch = observation.getNrBatches() / 2;
-    sample = observation.getNrSamplesPerBatch() / 2;
+    sample = layout.getNrSamplesPerBatch() / 2;
   }
 
-  for ( unsigned int channel = 0; channel < observation.getNrChannels(); channel++ ) {
+  for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
     float inverseFreq = 1.0f / std::pow(observation.getMinFreq() + (channel * observation.getChannelBandwidth()), 2.0f);
-    unsigned int shift = static_cast< unsigned int >(kDM * (inverseFreq - inverseHighFreq) * observation.getNrSamplesPerBatch());
+    unsigned int shift = static_cast< unsigned int >(kDM * (inverseFreq - inverseHighFreq) * layout.getNrSamplesPerBatch());
 
     for ( unsigned int i = 0; i < width; i++ ) {
-      if ( batch + ((sample + i + shift) / observation.getNrSamplesPerBatch()) >= observation.getNrBatches() ) {
-      break;
-      }
+      unsigned int pulseBatch = batch + ((sample + i + shift) / layout.getNrSamplesPerBatch());
+      unsigned int pulseSample = (sample + i + shift) % layout.getNrSamplesPerBatch();
 
-      if ( random ) {
-        if ( inputBits >= 8 ) {
-          data[batch + ((sample + i + shift) / observation.getNrSamplesPerBatch())]->at((channel * observation.getNrSamplesPerBatch(false, padding / sizeof(T))) + (sample + i + shift)) = static_cast< T >(std::rand() % 256);
+      if ( pulseBatch >= observation.getNrBatches() ) {
+        break;
+      }
+      if ( inputBits >= 8 ) {
+        if ( random ) {
+          data[pulseBatch]->at(layout.getIndex(channel, pulseSample)) = static_cast< T >(std::rand() % 256);
         } else {
-          uint8_t value = static_cast< unsigned int >(std::rand() % inputBits);
-          unsigned int byte = ((sample + i + shift) % observation.getNrSamplesPerBatch()) / (8 / inputBits);
-          uint8_t firstBit = (((sample + i + shift) % observation.getNrSamplesPerBatch()) % (8 / inputBits)) * inputBits;
-          unsigned char buffer = data[batch + ((sample + i + shift) / observation.getNrSamplesPerBatch())]->at((channel * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T))) + byte);
-
-          for ( uint8_t bit = 0; bit < inputBits; bit++ ) {
-            isa::utils::setBit(buffer, isa::utils::getBit(value, bit), firstBit + bit);
-          }
-          data[batch + ((sample + i + shift) / observation.getNrSamplesPerBatch())]->at((channel * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T))) + byte) = buffer;
+          data[pulseBatch]->at(layout.getIndex(channel, pulseSample)) = static_cast< T >(42);
         }
       } else {
-        if ( inputBits >= 8 ) {
-          data[batch + ((sample + i + shift) / observation.getNrSamplesPerBatch())]->at((channel * observation.getNrSamplesPerBatch(false, padding / sizeof(T))) + ((sample + i + shift) % observation.getNrSamplesPerBatch())) = static_cast< T >(42);
-        } else {
-          unsigned int byte = ((sample + i + shift) % observation.getNrSamplesPerBatch()) / (8 / inputBits);
-          uint8_t firstBit = (((sample + i + shift) % observation.getNrSamplesPerBatch()) % (8 / inputBits)) * inputBits;
-          unsigned char buffer = 0;
-
-          buffer = data[batch + ((sample + i + shift) / observation.getNrSamplesPerBatch())]->at((channel * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T))) + byte);
+        T & element = data[pulseBatch]->at(layout.getIndex(channel, pulseSample / layout.getNrSamplesPerElement()));
+        uint8_t firstBit = (pulseSample % layout.getNrSamplesPerElement()) * inputBits;
 
-          for ( uint8_t bit = 0; bit < inputBits; bit++ ) {
-            isa::utils::setBit(buffer, isa::utils::getBit(inputBits, bit), firstBit + bit);
-          }
-          data[batch + ((sample + i + shift) / observation.getNrSamplesPerBatch())]->at((channel * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T))) + byte) = buffer;
+        if ( random ) {
+          setPackedSample(element, static_cast< uint8_t >(std::rand() % inputBits), firstBit, inputBits);
+        } else {
+          setPackedSample(element, inputBits, firstBit, inputBits);
         }
       }
     }
   }
 }
 
-} // AstroData
+template< typename T > inline void setPackedSample(T & element, const uint8_t value, const uint8_t firstBit, const uint8_t inputBits) {
+  const uint8_t mask = ((1 << inputBits) - 1) << firstBit;
 
+  element = static_cast< T >((static_cast< uint8_t >(element) & ~mask) | ((value << firstBit) & mask));
+}
+
+} // AstroData
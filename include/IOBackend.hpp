@@ -0,0 +1,160 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstdint>
+
+#include "Platform.hpp"
+
+
+#pragma once
+
+#ifdef HAVE_LIBURING
+struct io_uring;
+#endif // HAVE_LIBURING
+
+namespace AstroData {
+
+// Read bytes starting at offset into buffer
+struct ReadRequest {
+  uint64_t offset;
+  uint64_t bytes;
+  uint8_t * buffer;
+};
+
+// Source of raw bytes for the readers
+class ByteSource {
+public:
+  virtual ~ByteSource();
+
+  virtual uint64_t getSize() const = 0;
+  // Start a read; the buffer must stay valid until wait() returns
+  virtual void submit(const ReadRequest & request) = 0;
+  // Wait for all submitted reads to complete
+  virtual void wait() = 0;
+  // Hint that a range will be read soon
+  virtual void prefetch(const uint64_t offset, const uint64_t bytes);
+  // Blocking read
+  void read(const uint64_t offset, const uint64_t bytes, uint8_t * buffer);
+};
+
+// Portable backend, blocking pread(2)
+class PreadSource : public ByteSource {
+public:
+  explicit PreadSource(const std::string & filename);
+  ~PreadSource();
+
+  uint64_t getSize() const;
+  void submit(const ReadRequest & request);
+  void wait();
+  void prefetch(const uint64_t offset, const uint64_t bytes);
+
+private:
+  std::string filename;
+  int file;
+  uint64_t size;
+};
+
+// In-memory backend, e.g. for tests
+class MemorySource : public ByteSource {
+public:
+  explicit MemorySource(std::vector<uint8_t> data);
+  ~MemorySource();
+
+  uint64_t getSize() const;
+  void submit(const ReadRequest & request);
+  void wait();
+
+private:
+  std::vector<uint8_t> data;
+};
+
+// Data regions of consecutive sources (e.g. the files of one observation), presented as one continuous stream
+// Reads that straddle two regions go directly into the caller's buffer
+class ConcatenatedSource : public ByteSource {
+public:
+  ConcatenatedSource();
+  ~ConcatenatedSource();
+
+  // Append the bytes of source starting at offset, e.g. after the file header
+  void append(std::unique_ptr<ByteSource> source, const uint64_t offset);
+  unsigned int getNrSources() const;
+  uint64_t getSize() const;
+  void submit(const ReadRequest & request);
+  void wait();
+  void prefetch(const uint64_t offset, const uint64_t bytes);
+
+private:
+  struct Region {
+    std::unique_ptr<ByteSource> source;
+    // Offset of the data in the source
+    uint64_t offset;
+    // Position of the data in the stream
+    uint64_t start;
+    uint64_t bytes;
+  };
+
+  unsigned int findRegion(const uint64_t position) const;
+
+  std::vector<Region> regions;
+  std::vector<unsigned int> active;
+  uint64_t size;
+};
+
+#ifdef HAVE_LIBURING
+// Linux io_uring backend; keeps up to queueDepth aligned O_DIRECT reads in flight into registered buffers
+class IOUringSource : public ByteSource {
+public:
+  IOUringSource(const std::string & filename, const unsigned int queueDepth = 32, const unsigned int bufferSize = 1 << 20);
+  ~IOUringSource();
+
+  uint64_t getSize() const;
+  void submit(const ReadRequest & request);
+  void wait();
+
+private:
+  // Part of a request that fits in one registered buffer
+  struct Chunk {
+    uint64_t alignedOffset;
+    uint64_t alignedBytes;
+    uint64_t skip;
+    uint64_t bytes;
+    uint8_t * destination;
+  };
+
+  void submitPending();
+  // Copy a completed chunk to its destination; false if the read failed
+  bool complete(const unsigned int buffer, const int result);
+  void release();
+
+  std::string filename;
+  int file;
+  uint64_t size;
+  unsigned int queueDepth;
+  unsigned int bufferSize;
+  unsigned int alignment;
+  std::unique_ptr<io_uring> ring;
+  std::vector<uint8_t *> buffers;
+  std::vector<unsigned int> freeBuffers;
+  std::vector<Chunk> inFlight;
+  std::deque<Chunk> pending;
+};
+#endif // HAVE_LIBURING
+
+} // AstroData
+
@@ -0,0 +1,193 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+
+#include "Observation.hpp"
+#include "StaticLayout.hpp"
+#include "BatchLayout.hpp"
+
+
+#pragma once
+
+namespace AstroData {
+
+// Simulated pulsar or FRB; times are in seconds, frequencies in MHz
+struct InjectedSignal {
+  // Pulse period, 0 for a single pulse; pulses repeat before and after arrivalTime
+  double period;
+  // Arrival time of one pulse at the highest frequency, from the start of the stream
+  double arrivalTime;
+  // Intrinsic full width at half maximum of the Gaussian pulse
+  double width;
+  // Scattering time at referenceFrequency, scaling with frequency^-4; 0 for no scattering
+  double scatteringTime;
+  float DM;
+  // Peak of the intrinsic pulse at referenceFrequency, in sample units
+  float amplitude;
+  // Amplitude scales with (frequency / referenceFrequency)^spectralIndex
+  float spectralIndex;
+  // Must be positive, also without spectral index and scattering
+  float referenceFrequency;
+};
+
+// Add the signal in place to one batch, the batch-th of the stream; needs the sampling time of the observation.
+// Dispersion smearing inside a channel widens the pulse; integer and packed samples saturate.
+template<typename T, typename L> void injectSignal(const L & layout, const Observation & observation, const InjectedSignal & signal, const uint64_t batch, T * data);
+// Add the signal to consecutive batches, the first being firstBatch in the stream
+template<typename T, typename L> void injectSignal(const L & layout, const Observation & observation, const InjectedSignal & signal, std::vector<std::vector<T> *> & data, const uint64_t firstBatch = 0);
+// Gaussian convolved with a one-sided exponential, with unit area
+inline double scatteredProfile(const double time, const double sigma, const double tau);
+// Add to a sample, saturating to the range of its type
+template<typename T> inline void addSample(T & sample, const float value);
+inline void addSample(float & sample, const float value);
+inline void addSample(double & sample, const float value);
+// Add to a sub-byte sample in a packed element, saturating to inputBits
+template<typename T> inline void addPackedSample(T & element, const float value, const uint8_t firstBit, const uint8_t inputBits);
+
+// Implementations
+
+template<typename T, typename L> void injectSignal(const L & layout, const Observation & observation, const InjectedSignal & signal, const uint64_t batch, T * data) {
+  const double samplingTime = observation.getSamplingTime();
+  const double firstTime = static_cast<double>(batch * layout.getNrSamplesPerBatch()) * samplingTime;
+  const double lastTime = firstTime + (layout.getNrSamplesPerBatch() * samplingTime);
+  const double inverseHighFreq = 1.0 / (static_cast<double>(observation.getMaxFreq()) * observation.getMaxFreq());
+  // Full width at half maximum to standard deviation
+  const double intrinsicSigma = signal.width / 2.3548200450309493;
+  const double fluence = signal.amplitude * intrinsicSigma * std::sqrt(2.0 * M_PI);
+
+  if ( samplingTime <= 0.0 ) {
+    throw ObservationError("ERROR: the sampling time of the observation is needed to inject signals");
+  }
+  if ( signal.referenceFrequency <= 0.0f ) {
+    throw ObservationError("ERROR: the reference frequency of the injected signal must be positive");
+  }
+  #pragma omp parallel for schedule(static)
+  for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
+    const double frequency = observation.getMinFreq() + (channel * observation.getChannelBandwidth());
+    const double delay = 4148.808 * signal.DM * ((1.0 / (frequency * frequency)) - inverseHighFreq);
+    // Dispersion smearing inside the channel, 8.3 us DM bandwidth(MHz) frequency(GHz)^-3
+    const double smearing = 8.3e-6 * signal.DM * observation.getChannelBandwidth() / std::pow(frequency / 1000.0, 3.0);
+    const double sigma = std::sqrt((intrinsicSigma * intrinsicSigma) + (smearing * smearing));
+    const double tau = signal.scatteringTime * std::pow(frequency / signal.referenceFrequency, -4.0);
+    const double channelFluence = fluence * std::pow(frequency / signal.referenceFrequency, static_cast<double>(signal.spectralIndex));
+    const double arrival = signal.arrivalTime + delay;
+    // Extent of one pulse around its arrival
+    const double before = 5.0 * sigma;
+    const double after = (5.0 * sigma) + (10.0 * tau);
+    int64_t firstPulse = 0;
+    int64_t lastPulse = 0;
+    std::vector<float> values(layout.getNrSamplesPerBatch());
+
+    if ( signal.period > 0.0 ) {
+      firstPulse = static_cast<int64_t>(std::ceil((firstTime - after - arrival) / signal.period));
+      lastPulse = static_cast<int64_t>(std::floor((lastTime + before - arrival) / signal.period));
+    }
+    for ( int64_t pulse = firstPulse; pulse <= lastPulse; pulse++ ) {
+      const double pulseTime = arrival + (pulse * signal.period);
+      // Samples are evaluated at their center
+      const int64_t firstSample = std::max(static_cast<int64_t>(0), static_cast<int64_t>(std::ceil(((pulseTime - before - firstTime) / samplingTime) - 0.5)));
+      const int64_t lastSample = std::min(static_cast<int64_t>(layout.getNrSamplesPerBatch()) - 1, static_cast<int64_t>(std::floor(((pulseTime + after - firstTime) / samplingTime) - 0.5)));
+      const double offset = firstTime + (0.5 * samplingTime) - pulseTime;
+      const unsigned int nrValues = (lastSample >= firstSample) ? static_cast<unsigned int>(lastSample - firstSample + 1) : 0;
+
+      if ( nrValues == 0 ) {
+        continue;
+      }
+      if ( tau <= 0.01 * sigma ) {
+        const double gaussianScale = channelFluence / (sigma * std::sqrt(2.0 * M_PI));
+        const double gaussianExponent = -0.5 / (sigma * sigma);
+
+        #pragma omp simd
+        for ( unsigned int value = 0; value < nrValues; value++ ) {
+          const double time = offset + ((firstSample + value) * samplingTime);
+
+          values[value] = static_cast<float>(gaussianScale * std::exp(gaussianExponent * time * time));
+        }
+      } else {
+        for ( unsigned int value = 0; value < nrValues; value++ ) {
+          values[value] = static_cast<float>(channelFluence * scatteredProfile(offset + ((firstSample + value) * samplingTime), sigma, tau));
+        }
+      }
+      if ( layout.getNrInputBits() >= 8 ) {
+        T * channelData = data + layout.getIndex(channel, firstSample);
+
+        for ( unsigned int value = 0; value < nrValues; value++ ) {
+          addSample(channelData[value], values[value]);
+        }
+      } else {
+        for ( unsigned int value = 0; value < nrValues; value++ ) {
+          const uint64_t sample = firstSample + value;
+
+          addPackedSample(data[layout.getIndex(channel, sample / layout.getNrSamplesPerElement())], values[value], (sample % layout.getNrSamplesPerElement()) * layout.getNrInputBits(), layout.getNrInputBits());
+        }
+      }
+    }
+  }
+}
+
+template<typename T, typename L> void injectSignal(const L & layout, const Observation & observation, const InjectedSignal & signal, std::vector<std::vector<T> *> & data, const uint64_t firstBatch) {
+  for ( unsigned int batch = 0; batch < data.size(); batch++ ) {
+    injectSignal(layout, observation, signal, firstBatch + batch, data.at(batch)->data());
+  }
+}
+
+inline double scatteredProfile(const double time, const double sigma, const double tau) {
+  const double z = ((sigma / tau) - (time / sigma)) / std::sqrt(2.0);
+
+  if ( z < 5.0 ) {
+    return (0.5 / tau) * std::exp(((sigma * sigma) / (2.0 * tau * tau)) - (time / tau)) * std::erfc(z);
+  }
+  // Asymptotic expansion of erfc, avoids overflowing the exponential
+  return (0.5 / tau) * std::exp(-(time * time) / (2.0 * sigma * sigma)) / (z * std::sqrt(M_PI)) * (1.0 - (1.0 / (2.0 * z * z)));
+}
+
+template<typename T> inline void addSample(T & sample, const float value) {
+  const double result = std::round(static_cast<double>(sample) + value);
+
+  if ( result >= static_cast<double>(std::numeric_limits<T>::max()) ) {
+    sample = std::numeric_limits<T>::max();
+  } else if ( result <= static_cast<double>(std::numeric_limits<T>::lowest()) ) {
+    sample = std::numeric_limits<T>::lowest();
+  } else {
+    sample = static_cast<T>(result);
+  }
+}
+
+inline void addSample(float & sample, const float value) {
+  sample += value;
+}
+
+inline void addSample(double & sample, const float value) {
+  sample += value;
+}
+
+template<typename T> inline void addPackedSample(T & element, const float value, const uint8_t firstBit, const uint8_t inputBits) {
+  const uint8_t mask = static_cast<uint8_t>((1 << inputBits) - 1);
+  uint8_t packed = static_cast<uint8_t>(element);
+  uint8_t sample = (packed >> firstBit) & mask;
+
+  addSample(sample, value);
+  sample = std::min(sample, mask);
+  packed = static_cast<uint8_t>((packed & ~(mask << firstBit)) | (sample << firstBit));
+  element = static_cast<T>(packed);
+}
+
+} // AstroData
+
@@ -0,0 +1,122 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#if defined(INSTRUMENTATION_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+
+#pragma once
+
+// Timers are compiled in only when ENABLE_INSTRUMENTATION is defined
+#ifdef ENABLE_INSTRUMENTATION
+#define ASTRODATA_TIMER(name, phase, bytes) AstroData::InstrumentationTimer name(phase, bytes)
+#else
+#define ASTRODATA_TIMER(name, phase, bytes)
+#endif // ENABLE_INSTRUMENTATION
+
+namespace AstroData {
+
+// Phases of a reader
+enum class InstrumentationPhase : unsigned int {
+  Read = 0,
+  Decode,
+  Transpose,
+  Allocate
+};
+const unsigned int nrInstrumentationPhases = 4;
+
+// Counters of one phase, summed over all threads
+struct PhaseCounters {
+  uint64_t calls;
+  uint64_t nanoseconds;
+  uint64_t bytes;
+};
+
+// Counters of one thread; only the owning thread writes them
+class ThreadCounters {
+public:
+  ThreadCounters();
+  ~ThreadCounters();
+
+  void add(const InstrumentationPhase phase, const uint64_t ticks, const uint64_t bytes);
+  PhaseCounters get(const InstrumentationPhase phase) const;
+  void reset();
+
+private:
+  std::atomic<uint64_t> calls[nrInstrumentationPhases];
+  std::atomic<uint64_t> ticks[nrInstrumentationPhases];
+  std::atomic<uint64_t> bytes[nrInstrumentationPhases];
+};
+
+// Counters of the calling thread
+ThreadCounters & getThreadCounters();
+// Counters of all threads, one entry per phase
+std::vector<PhaseCounters> getInstrumentationCounters();
+void resetInstrumentationCounters();
+std::string getPhaseName(const InstrumentationPhase phase);
+// Print the counters
+void dumpInstrumentationCounters(std::ostream & output);
+// Print the counters every period seconds (at least one) from a background thread; output must outlive the dump, that is stopped at exit at the latest
+void startInstrumentationDump(std::ostream & output, const unsigned int period);
+void stopInstrumentationDump();
+// Time source, in nanoseconds or TSC ticks when built with INSTRUMENTATION_RDTSC
+inline uint64_t getInstrumentationTicks();
+// Nanoseconds per tick of the time source
+double getInstrumentationTickPeriod();
+
+// Add the lifetime of the object to the counters of a phase
+class InstrumentationTimer {
+public:
+  InstrumentationTimer(const InstrumentationPhase phase, const uint64_t bytes = 0);
+  ~InstrumentationTimer();
+
+private:
+  InstrumentationPhase phase;
+  uint64_t bytes;
+  uint64_t start;
+};
+
+// Implementations
+inline void ThreadCounters::add(const InstrumentationPhase phase, const uint64_t ticks, const uint64_t bytes) {
+  const unsigned int index = static_cast<unsigned int>(phase);
+
+  this->calls[index].store(this->calls[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  this->ticks[index].store(this->ticks[index].load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+  this->bytes[index].store(this->bytes[index].load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+}
+
+inline uint64_t getInstrumentationTicks() {
+#if defined(INSTRUMENTATION_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline InstrumentationTimer::InstrumentationTimer(const InstrumentationPhase phase, const uint64_t bytes) : phase(phase), bytes(bytes), start(getInstrumentationTicks()) {}
+
+inline InstrumentationTimer::~InstrumentationTimer() {
+  getThreadCounters().add(phase, getInstrumentationTicks() - start, bytes);
+}
+
+} // AstroData
+
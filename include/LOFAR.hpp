@@ -0,0 +1,287 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#ifdef HAVE_HDF5
+#include <H5Cpp.h>
+#endif // HAVE_HDF5
+
+#include "Observation.hpp"
+#include "Platform.hpp"
+#include "IOBackend.hpp"
+
+
+#pragma once
+
+#ifdef HAVE_HDF5
+namespace AstroData {
+
+// One beam of a LOFAR beam-formed observation
+struct LOFARBeam {
+  unsigned int pointing;
+  unsigned int beam;
+  // HDF5 group of the beam, e.g. "/SUB_ARRAY_POINTING_000/BEAM_001"
+  std::string group;
+  // Metadata of the beam, with one batch per second of integration time
+  Observation observation;
+  uint64_t nrSamples;
+  // STOKES_0 is stored in the HDF5 file itself, and not in a raw file
+  bool internal;
+  // External raw file named by the dataset, if any, and where the data starts in it
+  std::string externalFilename;
+  uint64_t externalOffset;
+
+  uint64_t getNrBytesPerSample() const;
+};
+
+// Byte source over a two-dimensional [sample][channel] float dataset; bytes are big endian, as in LOFAR raw files,
+// and every read selects only the requested hyperslab
+class HDF5Source : public ByteSource {
+public:
+  HDF5Source(const std::string & filename, const std::string & dataset);
+  ~HDF5Source();
+
+  uint64_t getSize() const;
+  void submit(const ReadRequest & request);
+  void wait();
+
+private:
+  std::string filename;
+  H5::H5File file;
+  H5::DataSet data;
+  uint64_t nrRows;
+  uint64_t nrColumns;
+};
+
+// Metadata of all sub-array pointings and beams of a LOFAR header, read once
+class LOFARIndex {
+public:
+  explicit LOFARIndex(const std::string & headerFilename);
+  ~LOFARIndex();
+
+  unsigned int getNrBeams() const;
+  const LOFARBeam & getBeam(const unsigned int beam) const;
+  // Position in the index of a beam of a sub-array pointing
+  unsigned int findBeam(const unsigned int pointing, const unsigned int beam) const;
+  // Data of one beam: the HDF5 dataset if stored internally, otherwise the dataset's external file or rawFilename
+  std::unique_ptr<ByteSource> getSource(const unsigned int beam, const std::string & rawFilename = std::string()) const;
+
+private:
+  std::string headerFilename;
+  std::vector<LOFARBeam> beams;
+};
+
+// The HDF5 library is not thread safe by default
+inline std::mutex & getHDF5Mutex() {
+  static std::mutex hdf5Mutex;
+
+  return hdf5Mutex;
+}
+
+// Implementations
+
+inline uint64_t LOFARBeam::getNrBytesPerSample() const {
+  return static_cast<uint64_t>(observation.getNrChannels()) * sizeof(float);
+}
+
+inline HDF5Source::HDF5Source(const std::string & filename, const std::string & dataset) : filename(filename) {
+  std::lock_guard<std::mutex> lock(getHDF5Mutex());
+  hsize_t dimensions[2];
+
+  file = H5::H5File(filename, H5F_ACC_RDONLY);
+  data = file.openDataSet(dataset);
+  if ( data.getSpace().getSimpleExtentNdims() != 2 ) {
+    throw FileError("ERROR: dataset \"" + dataset + "\" of \"" + filename + "\" is not two-dimensional");
+  }
+  data.getSpace().getSimpleExtentDims(dimensions);
+  nrRows = dimensions[0];
+  nrColumns = dimensions[1];
+}
+
+inline HDF5Source::~HDF5Source() {
+  std::lock_guard<std::mutex> lock(getHDF5Mutex());
+
+  data.close();
+  file.close();
+}
+
+inline uint64_t HDF5Source::getSize() const {
+  return nrRows * nrColumns * sizeof(float);
+}
+
+inline void HDF5Source::submit(const ReadRequest & request) {
+  const uint64_t end = (request.offset + request.bytes) / sizeof(float);
+  uint64_t element = request.offset / sizeof(float);
+
+  if ( request.offset % sizeof(float) != 0 || request.bytes % sizeof(float) != 0 || request.offset + request.bytes > getSize() ) {
+    throw FileError("ERROR: impossible to read " + std::to_string(request.bytes) + " bytes at offset " + std::to_string(request.offset) + " from \"" + filename + "\"");
+  }
+  if ( request.bytes == 0 ) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(getHDF5Mutex());
+  H5::DataSpace fileSpace = data.getSpace();
+  hsize_t memoryDimensions[1] = {request.bytes / sizeof(float)};
+  H5::DataSpace memorySpace(1, memoryDimensions);
+
+  // Partial first row, whole rows, partial last row
+  fileSpace.selectNone();
+  while ( element < end ) {
+    hsize_t start[2] = {element / nrColumns, element % nrColumns};
+    hsize_t count[2] = {1, 0};
+
+    if ( start[1] != 0 || end - element < nrColumns ) {
+      count[1] = std::min(static_cast<uint64_t>(nrColumns - start[1]), end - element);
+    } else {
+      count[0] = (end - element) / nrColumns;
+      count[1] = nrColumns;
+    }
+    fileSpace.selectHyperslab(H5S_SELECT_OR, count, start);
+    element += count[0] * count[1];
+  }
+  data.read(reinterpret_cast<void *>(request.buffer), H5::PredType::IEEE_F32BE, memorySpace, fileSpace);
+}
+
+inline void HDF5Source::wait() {}
+
+inline LOFARIndex::LOFARIndex(const std::string & headerFilename) : headerFilename(headerFilename) {
+  const std::string pointingPrefix = "SUB_ARRAY_POINTING_";
+  const std::string beamPrefix = "BEAM_";
+  std::lock_guard<std::mutex> lock(getHDF5Mutex());
+  H5::H5File headerFile = H5::H5File(headerFilename, H5F_ACC_RDONLY);
+  H5::FloatType typeDouble = H5::FloatType(H5::PredType::NATIVE_DOUBLE);
+  H5::IntType typeUInt = H5::IntType(H5::PredType::NATIVE_UINT);
+  H5::Group root = headerFile.openGroup("/");
+  double minFreq = 0.0;
+
+  root.openAttribute("OBSERVATION_FREQUENCY_MIN").read(typeDouble, reinterpret_cast<void *>(&minFreq));
+  for ( hsize_t pointingObject = 0; pointingObject < root.getNumObjs(); pointingObject++ ) {
+    std::string pointingName = root.getObjnameByIdx(pointingObject);
+    double totalIntegrationTime = 0.0;
+    unsigned int nrBeams = 0;
+
+    if ( pointingName.compare(0, pointingPrefix.size(), pointingPrefix) != 0 || root.getObjTypeByIdx(pointingObject) != H5G_GROUP ) {
+      continue;
+    }
+    H5::Group pointing = root.openGroup(pointingName);
+
+    pointing.openAttribute("TOTAL_INTEGRATION_TIME").read(typeDouble, reinterpret_cast<void *>(&totalIntegrationTime));
+    pointing.openAttribute("NOF_BEAMS").read(typeUInt, reinterpret_cast<void *>(&nrBeams));
+    for ( hsize_t beamObject = 0; beamObject < pointing.getNumObjs(); beamObject++ ) {
+      std::string beamName = pointing.getObjnameByIdx(beamObject);
+      LOFARBeam beam;
+      unsigned int nrSamples = 0;
+      unsigned int nrStations = 0;
+      unsigned int nrChannels = 0;
+      unsigned int nrSubbands = 0;
+      double channelBandwidth = 0.0;
+
+      if ( beamName.compare(0, beamPrefix.size(), beamPrefix) != 0 || pointing.getObjTypeByIdx(beamObject) != H5G_GROUP ) {
+        continue;
+      }
+      H5::Group beamGroup = pointing.openGroup(beamName);
+
+      beamGroup.openAttribute("NOF_SAMPLES").read(typeUInt, reinterpret_cast<void *>(&nrSamples));
+      beamGroup.openAttribute("NOF_STATIONS").read(typeUInt, reinterpret_cast<void *>(&nrStations));
+      beamGroup.openAttribute("CHANNELS_PER_SUBBAND").read(typeUInt, reinterpret_cast<void *>(&nrChannels));
+      beamGroup.openAttribute("CHANNEL_WIDTH").read(typeDouble, reinterpret_cast<void *>(&channelBandwidth));
+      H5::DataSet stokes = beamGroup.openDataSet("STOKES_0");
+      stokes.openAttribute("NOF_SUBBANDS").read(typeUInt, reinterpret_cast<void *>(&nrSubbands));
+
+      beam.pointing = std::stoul(pointingName.substr(pointingPrefix.size()));
+      beam.beam = std::stoul(beamName.substr(beamPrefix.size()));
+      beam.group = "/" + pointingName + "/" + beamName;
+      beam.nrSamples = nrSamples;
+      beam.observation.setNrBeams(nrBeams);
+      beam.observation.setNrStations(nrStations);
+      beam.observation.setNrSamplesPerBatch(static_cast<unsigned int>(nrSamples / totalIntegrationTime));
+      beam.observation.setNrBatches(static_cast<unsigned int>(totalIntegrationTime));
+      beam.observation.setFrequencyRange(1, nrSubbands * nrChannels, minFreq, channelBandwidth / 1000000);
+      // Where the samples are stored
+      H5::DSetCreatPropList properties = stokes.getCreatePlist();
+      beam.internal = false;
+      beam.externalOffset = 0;
+      if ( properties.getExternalCount() > 0 ) {
+        char externalName[4096];
+        off_t externalOffset = 0;
+        hsize_t externalBytes = 0;
+
+        properties.getExternal(0, sizeof(externalName), externalName, externalOffset, externalBytes);
+        beam.externalFilename = std::string(externalName);
+        beam.externalOffset = externalOffset;
+      } else if ( stokes.getSpace().getSimpleExtentNdims() == 2 && stokes.getStorageSize() > 0 ) {
+        beam.internal = true;
+      }
+      beams.push_back(beam);
+    }
+  }
+  headerFile.close();
+  if ( beams.empty() ) {
+    throw FileError("ERROR: no beams in \"" + headerFilename + "\"");
+  }
+  std::sort(beams.begin(), beams.end(), [](const LOFARBeam & left, const LOFARBeam & right) {
+    return (left.pointing < right.pointing) || (left.pointing == right.pointing && left.beam < right.beam);
+  });
+}
+
+inline LOFARIndex::~LOFARIndex() {}
+
+inline unsigned int LOFARIndex::getNrBeams() const {
+  return beams.size();
+}
+
+inline const LOFARBeam & LOFARIndex::getBeam(const unsigned int beam) const {
+  return beams.at(beam);
+}
+
+inline unsigned int LOFARIndex::findBeam(const unsigned int pointing, const unsigned int beam) const {
+  for ( unsigned int item = 0; item < beams.size(); item++ ) {
+    if ( beams.at(item).pointing == pointing && beams.at(item).beam == beam ) {
+      return item;
+    }
+  }
+  throw FileError("ERROR: no beam " + std::to_string(beam) + " in pointing " + std::to_string(pointing) + " of \"" + headerFilename + "\"");
+}
+
+inline std::unique_ptr<ByteSource> LOFARIndex::getSource(const unsigned int beam, const std::string & rawFilename) const {
+  const LOFARBeam & item = beams.at(beam);
+
+  if ( item.internal ) {
+    return std::unique_ptr<ByteSource>(new HDF5Source(headerFilename, item.group + "/STOKES_0"));
+  } else if ( rawFilename.empty() && item.externalFilename.empty() ) {
+    throw FileError("ERROR: no raw file for beam " + std::to_string(item.beam) + " in pointing " + std::to_string(item.pointing) + " of \"" + headerFilename + "\"");
+  }
+  if ( !rawFilename.empty() ) {
+    return std::unique_ptr<ByteSource>(new PreadSource(rawFilename));
+  }
+  // External file names are relative to the header
+  std::string externalFilename = item.externalFilename;
+  std::unique_ptr<ConcatenatedSource> source(new ConcatenatedSource());
+
+  if ( externalFilename.at(0) != '/' && headerFilename.find('/') != std::string::npos ) {
+    externalFilename = headerFilename.substr(0, headerFilename.rfind('/') + 1) + externalFilename;
+  }
+  source->append(std::unique_ptr<ByteSource>(new PreadSource(externalFilename)), item.externalOffset);
+  return std::unique_ptr<ByteSource>(source.release());
+}
+
+} // AstroData
+#endif // HAVE_HDF5
+
@@ -0,0 +1,71 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include <cstdint>
+#include <sched.h>
+
+
+#pragma once
+
+namespace AstroData {
+
+// Placement of batches on NUMA nodes
+enum class NUMAMode {
+  // Wherever the allocating thread happens to run
+  Default,
+  // Batches round-robin over all nodes
+  Interleave,
+  // All batches on one node, e.g. the node of the consuming worker
+  Bind
+};
+
+struct NUMAPolicy {
+  NUMAMode mode;
+  unsigned int node;
+};
+
+// IDs of the online NUMA nodes, that may not be contiguous; node 0 only if the system does not expose them
+const std::vector<unsigned int> & getNUMANodes();
+unsigned int getNrNUMANodes();
+// Node of the CPU the calling thread runs on, e.g. to bind batches to a consuming worker
+unsigned int getCurrentNUMANode();
+// CPUs belonging to a NUMA node
+std::vector<unsigned int> getNUMANodeCPUs(const unsigned int node);
+// Node where the batch should be placed according to the policy
+unsigned int getPolicyNode(const NUMAPolicy & policy, const unsigned int batch);
+// Restrict the calling thread to the CPUs of a node
+void pinThreadToNode(const unsigned int node);
+// Move memory according to the policy (mbind, without libnuma); pointer must be page aligned, and the pages up to pointer + bytes
+// must belong to the caller, e.g. from allocateNUMAMemory, because the policy applies to whole pages and outlives the allocation.
+// False if the memory is not page aligned or the kernel refused the policy.
+bool placeMemory(void * pointer, const uint64_t bytes, const NUMAPolicy & policy);
+// Whole pages, placed according to the policy before the first touch; throws std::bad_alloc
+void * allocateNUMAMemory(const uint64_t bytes, const NUMAPolicy & policy);
+void releaseNUMAMemory(void * pointer, const uint64_t bytes);
+
+// Restore the CPU affinity of the calling thread on destruction
+class ScopedAffinity {
+public:
+  ScopedAffinity();
+  ~ScopedAffinity();
+
+private:
+  cpu_set_t affinity;
+  bool saved;
+};
+
+} // AstroData
+
@@ -15,6 +15,11 @@
 
 #include <string>
 #include <limits>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <cstdint>
+#include <exception>
 
 #include <utils.hpp>
 
@@ -23,6 +28,21 @@
 
 namespace AstroData {
 
+// Exception: malformed or incompatible serialized observation
+class ObservationError : public std::exception {
+public:
+  explicit ObservationError(const std::string & message);
+  ~ObservationError() noexcept;
+
+  const char * what() const noexcept;
+
+private:
+  std::string message;
+};
+
+// Version of the serialized observation format
+const uint32_t observationSerializationVersion = 1;
+
 class Observation {
 public:
   Observation();
@@ -78,6 +98,16 @@ public:
   void setPeriodRange(const unsigned int periods, const unsigned int basePeriod, const unsigned int step);
   void setNrBins(const unsigned int bins);
 
+  // Serialization
+  // Hash of the parameters that determine the shape of the data buffers
+  uint64_t getLayoutHash() const;
+  // Versioned binary snapshot
+  void serialize(std::vector<uint8_t> & buffer) const;
+  void deserialize(const std::vector<uint8_t> & buffer);
+  // Human-readable "key value" representation
+  void serializeText(std::ostream & output) const;
+  void deserializeText(std::istream & input);
+
 private:
   unsigned int nrBatches;
   unsigned int nrStations;
@@ -0,0 +1,471 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include <map>
+#include <string>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+
+#include "ReadData.hpp"
+
+
+#pragma once
+
+namespace AstroData {
+
+// Exception: the pipeline is not complete
+class PipelineError : public std::exception {
+public:
+  explicit PipelineError(const std::string & message);
+  ~PipelineError() noexcept;
+
+  const char * what() const noexcept;
+
+private:
+  std::string message;
+};
+
+// Bounded multi-producer multi-consumer queue, lock-free (Vyukov); the capacity is rounded up to a power of two
+template<typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(const unsigned int capacity);
+  ~BoundedQueue();
+
+  // False if the queue is full
+  bool tryPush(const T & item);
+  // False if the queue is empty
+  bool tryPop(T & item);
+  unsigned int getCapacity() const;
+
+private:
+  struct Cell {
+    std::atomic<uint64_t> sequence;
+    T item;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  uint64_t mask;
+  std::atomic<uint64_t> enqueuePosition;
+  // Producers and consumers on different cache lines; alignas is not honoured by new before C++17
+  char separator[64];
+  std::atomic<uint64_t> dequeuePosition;
+};
+
+// Chain of a source, transforms and a sink, connected by bounded queues of pooled batches.
+// Every stage has its own threads; the source waits for a free batch, and every stage for space in the next queue,
+// so that a slow stage holds back the stages before it. Consecutive element-wise transforms are fused in one stage.
+template<typename T> class Pipeline {
+public:
+  // Fill data with the batch-th batch of the stream; false at the end of the stream
+  typedef std::function<bool(const uint64_t batch, T * data)> SourceFunction;
+  // Process a batch in place
+  typedef std::function<void(const uint64_t batch, T * data)> TransformFunction;
+  // The same operation on every element of a range of a batch, padding included
+  typedef std::function<void(T * data, const uint64_t nrElements)> ElementWiseFunction;
+  typedef std::function<void(const uint64_t batch, const T * data)> SinkFunction;
+
+  // nrBuffers batches of nrElementsPerBatch elements (e.g. layout.getNrElementsPerBatch()) are shared by all stages;
+  // fused element-wise transforms run on chunks of chunkSize elements, that stay in cache
+  Pipeline(const uint64_t nrElementsPerBatch, const unsigned int nrBuffers, const unsigned int queueDepth = 4, const unsigned int chunkSize = 8192);
+  ~Pipeline();
+
+  void setSource(SourceFunction source);
+  // Batches may leave a stage with more than one thread out of order
+  void addTransform(TransformFunction transform, const unsigned int nrThreads = 1);
+  void addElementWise(ElementWiseFunction transform, const unsigned int nrThreads = 1);
+  // An ordered sink receives the batches in stream order, on one thread
+  void setSink(SinkFunction sink, const bool ordered = true, const unsigned int nrThreads = 1);
+  // Process the whole stream; the first exception of a stage stops all stages and is rethrown
+  void run();
+  // Stages between source and sink, after fusion
+  unsigned int getNrStages() const;
+  // Threads used by run()
+  unsigned int getNrThreads() const;
+  // Batches received by the sink
+  uint64_t getNrBatches() const;
+
+private:
+  // Position of a batch in the stream and its buffer in the pool
+  struct Token {
+    uint64_t batch;
+    unsigned int buffer;
+  };
+
+  struct Stage {
+    TransformFunction transform;
+    std::vector<ElementWiseFunction> elementWise;
+    unsigned int nrThreads;
+    std::unique_ptr<BoundedQueue<Token>> input;
+    std::atomic<unsigned int> nrFinishedThreads;
+  };
+
+  void runSource();
+  void runStage(const unsigned int stage);
+  void runSink();
+  // Blocking queue operations; false if another stage failed
+  template<typename V> bool push(BoundedQueue<V> & queue, const V & item);
+  template<typename V> bool pop(BoundedQueue<V> & queue, V & item);
+  // Pass the end of the stream to all threads of a stage
+  void finish(BoundedQueue<Token> & queue, const unsigned int nrThreads);
+  void fail();
+
+  uint64_t nrElementsPerBatch;
+  unsigned int queueDepth;
+  unsigned int chunkSize;
+  std::vector<std::vector<T>> buffers;
+  BoundedQueue<unsigned int> freeBuffers;
+  SourceFunction source;
+  std::vector<std::unique_ptr<Stage>> stages;
+  SinkFunction sink;
+  bool ordered;
+  unsigned int nrSinkThreads;
+  std::unique_ptr<BoundedQueue<Token>> sinkInput;
+  std::atomic<uint64_t> nrBatches;
+  std::atomic<bool> failed;
+  std::mutex errorMutex;
+  std::exception_ptr error;
+};
+
+// Source reading and transposing consecutive SIGPROC batches, e.g. for Pipeline::setSource; the layout is copied, the source must outlive the pipeline
+template<typename T, typename L> typename Pipeline<T>::SourceFunction getSIGPROCSource(const L & layout, ByteSource & source, const uint64_t bytesToSkip, const uint64_t nrBatches);
+
+// Implementations
+
+template<typename T> BoundedQueue<T>::BoundedQueue(const unsigned int capacity) : enqueuePosition(0), dequeuePosition(0) {
+  uint64_t size = 2;
+
+  while ( size < capacity ) {
+    size *= 2;
+  }
+  cells.reset(new Cell[size]);
+  mask = size - 1;
+  for ( uint64_t cell = 0; cell < size; cell++ ) {
+    cells[cell].sequence.store(cell, std::memory_order_relaxed);
+  }
+}
+
+template<typename T> BoundedQueue<T>::~BoundedQueue() {}
+
+template<typename T> bool BoundedQueue<T>::tryPush(const T & item) {
+  uint64_t position = enqueuePosition.load(std::memory_order_relaxed);
+  Cell * cell = 0;
+
+  while ( true ) {
+    cell = &cells[position & mask];
+    const uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+
+    if ( difference == 0 ) {
+      if ( enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed) ) {
+        break;
+      }
+    } else if ( difference < 0 ) {
+      return false;
+    } else {
+      position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+  }
+  cell->item = item;
+  cell->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename T> bool BoundedQueue<T>::tryPop(T & item) {
+  uint64_t position = dequeuePosition.load(std::memory_order_relaxed);
+  Cell * cell = 0;
+
+  while ( true ) {
+    cell = &cells[position & mask];
+    const uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position + 1);
+
+    if ( difference == 0 ) {
+      if ( dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed) ) {
+        break;
+      }
+    } else if ( difference < 0 ) {
+      return false;
+    } else {
+      position = dequeuePosition.load(std::memory_order_relaxed);
+    }
+  }
+  item = cell->item;
+  cell->sequence.store(position + mask + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename T> inline unsigned int BoundedQueue<T>::getCapacity() const {
+  return mask + 1;
+}
+
+template<typename T> Pipeline<T>::Pipeline(const uint64_t nrElementsPerBatch, const unsigned int nrBuffers, const unsigned int queueDepth, const unsigned int chunkSize) : nrElementsPerBatch(nrElementsPerBatch), queueDepth(queueDepth), chunkSize(std::max(chunkSize, 1u)), buffers(std::max(nrBuffers, 1u)), freeBuffers(std::max(nrBuffers, 1u)), ordered(true), nrSinkThreads(1), nrBatches(0), failed(false) {}
+
+template<typename T> Pipeline<T>::~Pipeline() {}
+
+template<typename T> void Pipeline<T>::setSource(SourceFunction source) {
+  this->source = source;
+}
+
+template<typename T> void Pipeline<T>::addTransform(TransformFunction transform, const unsigned int nrThreads) {
+  std::unique_ptr<Stage> stage(new Stage());
+
+  stage->transform = transform;
+  stage->nrThreads = std::max(nrThreads, 1u);
+  stages.push_back(std::move(stage));
+}
+
+template<typename T> void Pipeline<T>::addElementWise(ElementWiseFunction transform, const unsigned int nrThreads) {
+  if ( stages.empty() || stages.back()->elementWise.empty() ) {
+    stages.push_back(std::unique_ptr<Stage>(new Stage()));
+    stages.back()->nrThreads = 1;
+  }
+  // Fused with the previous element-wise transforms
+  stages.back()->elementWise.push_back(transform);
+  stages.back()->nrThreads = std::max(stages.back()->nrThreads, nrThreads);
+}
+
+template<typename T> void Pipeline<T>::setSink(SinkFunction sink, const bool ordered, const unsigned int nrThreads) {
+  this->sink = sink;
+  this->ordered = ordered;
+  nrSinkThreads = ordered ? 1 : std::max(nrThreads, 1u);
+}
+
+template<typename T> void Pipeline<T>::run() {
+  std::vector<std::thread> threads;
+  unsigned int freeBuffer = 0;
+
+  if ( !source || !sink ) {
+    throw PipelineError("ERROR: a pipeline needs a source and a sink");
+  }
+  // Buffers left in the queues by a failed run are back in the pool
+  while ( freeBuffers.tryPop(freeBuffer) ) {}
+  for ( unsigned int buffer = 0; buffer < buffers.size(); buffer++ ) {
+    buffers.at(buffer).resize(nrElementsPerBatch);
+    freeBuffers.tryPush(buffer);
+  }
+  for ( unsigned int stage = 0; stage < stages.size(); stage++ ) {
+    stages.at(stage)->input.reset(new BoundedQueue<Token>(std::max(queueDepth, stages.at(stage)->nrThreads)));
+    stages.at(stage)->nrFinishedThreads = 0;
+  }
+  sinkInput.reset(new BoundedQueue<Token>(std::max(queueDepth, nrSinkThreads)));
+  nrBatches = 0;
+  failed = false;
+  error = std::exception_ptr();
+  threads.push_back(std::thread(&Pipeline<T>::runSource, this));
+  for ( unsigned int stage = 0; stage < stages.size(); stage++ ) {
+    for ( unsigned int thread = 0; thread < stages.at(stage)->nrThreads; thread++ ) {
+      threads.push_back(std::thread(&Pipeline<T>::runStage, this, stage));
+    }
+  }
+  for ( unsigned int thread = 0; thread < nrSinkThreads; thread++ ) {
+    threads.push_back(std::thread(&Pipeline<T>::runSink, this));
+  }
+  for ( unsigned int thread = 0; thread < threads.size(); thread++ ) {
+    threads.at(thread).join();
+  }
+  if ( error ) {
+    std::rethrow_exception(error);
+  }
+}
+
+template<typename T> inline unsigned int Pipeline<T>::getNrStages() const {
+  return stages.size();
+}
+
+template<typename T> unsigned int Pipeline<T>::getNrThreads() const {
+  unsigned int nrThreads = 1 + nrSinkThreads;
+
+  for ( unsigned int stage = 0; stage < stages.size(); stage++ ) {
+    nrThreads += stages.at(stage)->nrThreads;
+  }
+  return nrThreads;
+}
+
+template<typename T> inline uint64_t Pipeline<T>::getNrBatches() const {
+  return nrBatches;
+}
+
+template<typename T> void Pipeline<T>::runSource() {
+  BoundedQueue<Token> & output = stages.empty() ? *sinkInput : *(stages.front()->input);
+  const unsigned int nrOutputThreads = stages.empty() ? nrSinkThreads : stages.front()->nrThreads;
+
+  try {
+    for ( uint64_t batch = 0; ; batch++ ) {
+      Token token = {batch, 0};
+
+      if ( !pop(freeBuffers, token.buffer) ) {
+        return;
+      }
+      if ( !source(batch, buffers.at(token.buffer).data()) ) {
+        freeBuffers.tryPush(token.buffer);
+        break;
+      }
+      if ( !push(output, token) ) {
+        return;
+      }
+    }
+    finish(output, nrOutputThreads);
+  } catch ( ... ) {
+    fail();
+  }
+}
+
+template<typename T> void Pipeline<T>::runStage(const unsigned int stage) {
+  Stage & current = *(stages.at(stage));
+  BoundedQueue<Token> & output = (stage + 1 < stages.size()) ? *(stages.at(stage + 1)->input) : *sinkInput;
+  const unsigned int nrOutputThreads = (stage + 1 < stages.size()) ? stages.at(stage + 1)->nrThreads : nrSinkThreads;
+
+  try {
+    while ( true ) {
+      Token token;
+
+      if ( !pop(*(current.input), token) ) {
+        return;
+      }
+      if ( token.buffer == static_cast<unsigned int>(buffers.size()) ) {
+        // The last thread to see the end of the stream passes it on
+        if ( ++current.nrFinishedThreads == current.nrThreads ) {
+          finish(output, nrOutputThreads);
+        }
+        return;
+      }
+      T * data = buffers.at(token.buffer).data();
+
+      if ( current.elementWise.empty() ) {
+        current.transform(token.batch, data);
+      } else {
+        for ( uint64_t first = 0; first < nrElementsPerBatch; first += chunkSize ) {
+          const uint64_t nrElements = std::min(static_cast<uint64_t>(chunkSize), nrElementsPerBatch - first);
+
+          for ( unsigned int transform = 0; transform < current.elementWise.size(); transform++ ) {
+            current.elementWise.at(transform)(data + first, nrElements);
+          }
+        }
+      }
+      if ( !push(output, token) ) {
+        return;
+      }
+    }
+  } catch ( ... ) {
+    fail();
+  }
+}
+
+template<typename T> void Pipeline<T>::runSink() {
+  // Batches that arrived before the previous ones, for ordered sinks
+  std::map<uint64_t, unsigned int> pending;
+  uint64_t next = 0;
+
+  try {
+    while ( true ) {
+      Token token;
+
+      if ( !pop(*sinkInput, token) ) {
+        return;
+      }
+      if ( token.buffer == static_cast<unsigned int>(buffers.size()) ) {
+        return;
+      }
+      if ( !ordered ) {
+        sink(token.batch, buffers.at(token.buffer).data());
+        nrBatches++;
+        push(freeBuffers, token.buffer);
+        continue;
+      }
+      pending[token.batch] = token.buffer;
+      while ( !pending.empty() && pending.begin()->first == next ) {
+        sink(next, buffers.at(pending.begin()->second).data());
+        nrBatches++;
+        push(freeBuffers, pending.begin()->second);
+        pending.erase(pending.begin());
+        next++;
+      }
+    }
+  } catch ( ... ) {
+    fail();
+  }
+}
+
+template<typename T> template<typename V> bool Pipeline<T>::push(BoundedQueue<V> & queue, const V & item) {
+  unsigned int attempt = 0;
+
+  while ( !queue.tryPush(item) ) {
+    if ( failed ) {
+      return false;
+    }
+    // Spin briefly, then give up the core to the stages that have work
+    if ( ++attempt > 64 ) {
+      std::this_thread::sleep_for(std::chrono::microseconds(attempt > 1024 ? 100 : 0));
+    }
+  }
+  return true;
+}
+
+template<typename T> template<typename V> bool Pipeline<T>::pop(BoundedQueue<V> & queue, V & item) {
+  unsigned int attempt = 0;
+
+  while ( !queue.tryPop(item) ) {
+    if ( failed ) {
+      return false;
+    }
+    if ( ++attempt > 64 ) {
+      std::this_thread::sleep_for(std::chrono::microseconds(attempt > 1024 ? 100 : 0));
+    }
+  }
+  return true;
+}
+
+template<typename T> void Pipeline<T>::finish(BoundedQueue<Token> & queue, const unsigned int nrThreads) {
+  const Token end = {0, static_cast<unsigned int>(buffers.size())};
+
+  for ( unsigned int thread = 0; thread < nrThreads; thread++ ) {
+    if ( !push(queue, end) ) {
+      return;
+    }
+  }
+}
+
+template<typename T> void Pipeline<T>::fail() {
+  std::lock_guard<std::mutex> lock(errorMutex);
+
+  if ( !error ) {
+    error = std::current_exception();
+  }
+  failed = true;
+}
+
+template<typename T, typename L> typename Pipeline<T>::SourceFunction getSIGPROCSource(const L & layout, ByteSource & source, const uint64_t bytesToSkip, const uint64_t nrBatches) {
+  std::shared_ptr<std::vector<uint8_t>> raw(new std::vector<uint8_t>(layout.getNrInputBytesPerBatch()));
+
+  return [layout, &source, bytesToSkip, nrBatches, raw](const uint64_t batch, T * data) {
+    if ( batch >= nrBatches ) {
+      return false;
+    }
+    source.read(bytesToSkip + (batch * layout.getNrInputBytesPerBatch()), raw->size(), raw->data());
+    unpackSIGPROC(layout, raw->data(), data);
+    return true;
+  };
+}
+
+} // AstroData
+
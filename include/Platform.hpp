@@ -16,6 +16,7 @@
 #include <string>
 #include <map>
 #include <fstream>
+#include <cstdint>
 
 #include <utils.hpp>
 
@@ -35,6 +36,22 @@ private:
   std::string message;
 };
 
+// Read-only memory map of a whole file; kind names the file in errors, e.g. "padding"
+class MappedFile {
+public:
+  MappedFile(const std::string & filename, const std::string & kind);
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+  ~MappedFile();
+
+  const char * getData() const;
+  uint64_t getSize() const;
+
+private:
+  void * data;
+  uint64_t size;
+};
+
 // Memory padding
 typedef std::map<std::string, unsigned int> paddingConf;
 // Vector unit width
@@ -43,6 +60,20 @@ typedef std::map<std::string, unsigned int> vectorWidthConf;
 // Read configuration files
 void readPaddingConf(paddingConf & padding, const std::string & paddingFilename);
 void readVectorWidthConf(vectorWidthConf & vectorWidth, const std::string & vectorFilename);
+// Parse "device value" lines; lines not starting with a letter are skipped, malformed lines are reported with their number
+void parseDeviceConf(const char * text, const uint64_t size, const std::string & filename, std::map<std::string, unsigned int> & values);
+// Parse an unsigned integer at position, advancing it; false if there are no digits or the value overflows
+bool parseUnsigned(const char * & position, const char * end, unsigned int & value);
+
+// Implementations
+
+inline const char * MappedFile::getData() const {
+  return static_cast<const char *>(data);
+}
+
+inline uint64_t MappedFile::getSize() const {
+  return size;
+}
 
 } // AstroData
 
@@ -19,7 +19,14 @@
 #include <string>
 #include <cstring>
 #include <cmath>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <exception>
+#ifdef _OPENMP
+#include <omp.h>
+#endif // _OPENMP
 #ifdef HAVE_HDF5
 #include <H5Cpp.h>
 #endif // HAVE_HDF5
@@ -31,6 +38,14 @@
 #include <utils.hpp>
 #include "Observation.hpp"
 #include "Platform.hpp"
+#include "Configuration.hpp"
+#include "StaticLayout.hpp"
+#include "BatchLayout.hpp"
+#include "Instrumentation.hpp"
+#include "IOBackend.hpp"
+#include "NUMA.hpp"
+#include "LOFAR.hpp"
+#include "Conversion.hpp"
 
 
 #pragma once
@@ -48,16 +63,48 @@ private:
   std::string message;
 };
 
-// Zapped channels (excluded from computation)
-void readZappedChannels(Observation & observation, const std::string & inputFileName, std::vector<unsigned int> & zappedChannels);
-// Integration steps
-void readIntegrationSteps(const Observation & observation, const std::string  & inputFileName, std::set<unsigned int> & integrationSteps);
 // SIGPROC data
 template<typename T> void readSIGPROC(const Observation & observation, const unsigned int padding, const uint8_t inputBits, const unsigned int bytesToSkip, const std::string & inputFilename, std::vector<std::vector<T> *> & data, const unsigned int firstBatch = 0);
+// SIGPROC data with a batch layout (e.g. StaticLayout); sizeof(T) must match the layout's element size
+template<typename T, typename L> void readSIGPROC(const L & layout, const Observation & observation, const unsigned int bytesToSkip, const std::string & inputFilename, std::vector<std::vector<T> *> & data, const unsigned int firstBatch = 0, const NUMAPolicy & policy = NUMAPolicy{NUMAMode::Default, 0});
+template<typename T, typename L> void readSIGPROC(const L & layout, const Observation & observation, ByteSource & source, const uint64_t bytesToSkip, std::vector<std::vector<T> *> & data, const unsigned int firstBatch = 0, const NUMAPolicy & policy = NUMAPolicy{NUMAMode::Default, 0});
+// Transpose one batch of raw SIGPROC samples into the channel-major layout
+template<typename T, typename L> void unpackSIGPROC(const L & layout, const uint8_t * input, T * output);
+// SIGPROC data converted while decoding, e.g. 2 bit files to float, or requantised to 8 bit with a scale and offset per channel (see convertBatch);
+// inputLayout describes the file, outputLayout the batches
+template<typename O, typename LI, typename LO> void readConvertedSIGPROC(const LI & inputLayout, const LO & outputLayout, const Observation & observation, ByteSource & source, const uint64_t bytesToSkip, std::vector<std::vector<O> *> & data, const std::vector<float> & scale = std::vector<float>(), const std::vector<float> & offset = std::vector<float>(), const unsigned int firstBatch = 0);
+// Samples of one channel of a raw SIGPROC batch, as float
+template<typename L> inline void loadSIGPROCChannel(const L & layout, const uint8_t * input, const unsigned int channel, float * samples);
+// Multi-beam SIGPROC data, one file per beam; see readMultiBeamBatches for the layout
+template<typename T> void readMultiBeamSIGPROC(const Observation & observation, const unsigned int padding, const uint8_t inputBits, const unsigned int bytesToSkip, const std::vector<std::string> & inputFilenames, std::vector<std::vector<T> *> & data, const unsigned int firstBatch = 0);
+template<typename T, typename L> void readMultiBeamSIGPROC(const L & layout, const Observation & observation, const unsigned int bytesToSkip, const std::vector<std::string> & inputFilenames, std::vector<std::vector<T> *> & data, const unsigned int firstBatch = 0);
+template<typename T, typename L> void readMultiBeamSIGPROC(const L & layout, const Observation & observation, std::vector<ByteSource *> & sources, const uint64_t bytesToSkip, std::vector<std::vector<T> *> & data, const unsigned int firstBatch = 0);
+// Multi-file observations: the data of consecutive files presented as one continuous stream of batches
+// Append one file, after checking that fileObservation matches the files already appended; observation counts the complete batches of all files
+void appendRawFile(ConcatenatedSource & source, Observation & observation, const Observation & fileObservation, const std::string & filename, const uint64_t bytesToSkip, const uint8_t inputBits);
 #ifdef HAVE_HDF5
 // LOFAR data
 template<typename T> void readLOFAR(std::string headerFilename, std::string rawFilename, Observation & observation, const unsigned int padding, std::vector<std::vector<T> *> & data, unsigned int nrBatches = 0, unsigned int firstBatch = 0);
+// LOFAR metadata of one beam (position in the LOFARIndex), with one batch per second of integration time
+inline void readLOFARHeader(const std::string & headerFilename, Observation & observation, const unsigned int beam = 0);
+// Append a LOFAR raw file to a multi-file observation
+inline void appendLOFAR(ConcatenatedSource & source, Observation & observation, const std::string & headerFilename, const std::string & rawFilename);
+// Multi-beam LOFAR data, one header and raw file per beam; sets the number of beams
+template<typename T> void readMultiBeamLOFAR(const std::vector<std::string> & headerFilenames, const std::vector<std::string> & rawFilenames, Observation & observation, const unsigned int padding, std::vector<std::vector<T> *> & data, unsigned int nrBatches = 0, unsigned int firstBatch = 0);
+template<typename T, typename L> void readMultiBeamLOFAR(const L & layout, const Observation & observation, std::vector<ByteSource *> & sources, std::vector<std::vector<T> *> & data, const unsigned int firstBatch = 0);
+// LOFAR raw data with a batch layout, for an observation already described
+template<typename T, typename L> void readLOFAR(const L & layout, const Observation & observation, const std::string & rawFilename, std::vector<std::vector<T> *> & data, const unsigned int firstBatch = 0, const NUMAPolicy & policy = NUMAPolicy{NUMAMode::Default, 0});
+template<typename T, typename L> void readLOFAR(const L & layout, const Observation & observation, ByteSource & source, std::vector<std::vector<T> *> & data, const unsigned int firstBatch = 0, const NUMAPolicy & policy = NUMAPolicy{NUMAMode::Default, 0});
+// Transpose one batch of raw LOFAR samples into the channel-major layout
+template<typename T, typename L> void unpackLOFAR(const L & layout, const uint8_t * input, T * output);
 #endif // HAVE_HDF5
+// Read consecutive raw batches starting at offset, and convert each with unpack(input, output)
+// With a NUMA policy, batches are allocated and unpacked in parallel by threads pinned to the batch's node
+template<typename T, typename L, typename U> void readRawBatches(const L & layout, const Observation & observation, ByteSource & source, const uint64_t offset, std::vector<std::vector<T> *> & data, U unpack, const NUMAPolicy & policy = NUMAPolicy{NUMAMode::Default, 0});
+template<typename T, typename L, typename U> void readRawBatchesNUMA(const L & layout, const Observation & observation, ByteSource & source, const uint64_t offset, std::vector<std::vector<T> *> & data, U unpack, const NUMAPolicy & policy);
+// Read the same batches from one source per beam into beam-major batches: beam b of a batch starts at element b * layout.getNrElementsPerBatch(),
+// the order used by generateBeamMapping and readBeamMapping; batches and beams are decoded in parallel
+template<typename T, typename L, typename U> void readMultiBeamBatches(const L & layout, const Observation & observation, std::vector<ByteSource *> & sources, const uint64_t offset, std::vector<std::vector<T> *> & data, U unpack);
 #ifdef HAVE_PSRDADA
 // PSRDADA buffer
 void readPSRDADAHeader(Observation & observation, dada_hdu_t & ringBuffer);
@@ -67,152 +114,377 @@ template<typename T> inline void readPSRDADA(dada_hdu_t & ringBuffer, std::vecto
 // Implementations
 
 template<typename T> void readSIGPROC(const Observation & observation, const unsigned int padding, const uint8_t inputBits, const unsigned int bytesToSkip, const std::string & inputFilename, std::vector<std::vector<T> *> & data, const unsigned int firstBatch) {
-  std::ifstream inputFile;
-  const unsigned int BUFFER_DIM = sizeof(T);
-  char * buffer = new char [BUFFER_DIM];
+  readSIGPROC(BatchLayout<T>(observation, padding, inputBits), observation, bytesToSkip, inputFilename, data, firstBatch);
+}
+
+template<typename T, typename L> void readSIGPROC(const L & layout, const Observation & observation, const unsigned int bytesToSkip, const std::string & inputFilename, std::vector<std::vector<T> *> & data, const unsigned int firstBatch, const NUMAPolicy & policy) {
+  PreadSource source(inputFilename);
+
+  readSIGPROC(layout, observation, source, bytesToSkip, data, firstBatch, policy);
+}
 
-  inputFile.open(inputFilename.c_str(), std::ios::binary);
-  if ( ! inputFile ) {
-    delete [] buffer;
-    throw FileError("ERROR: impossible to open SIGPROC file \"" + inputFilename + "\"");
+template<typename T, typename L> void readSIGPROC(const L & layout, const Observation & observation, ByteSource & source, const uint64_t bytesToSkip, std::vector<std::vector<T> *> & data, const unsigned int firstBatch, const NUMAPolicy & policy) {
+  readRawBatches(layout, observation, source, bytesToSkip + (static_cast<uint64_t>(firstBatch) * layout.getNrInputBytesPerBatch()), data, [&layout](const uint8_t * input, T * output) {
+    unpackSIGPROC(layout, input, output);
+  }, policy);
+}
+
+template<typename O, typename LI, typename LO> void readConvertedSIGPROC(const LI & inputLayout, const LO & outputLayout, const Observation & observation, ByteSource & source, const uint64_t bytesToSkip, std::vector<std::vector<O> *> & data, const std::vector<float> & scale, const std::vector<float> & offset, const unsigned int firstBatch) {
+  if ( inputLayout.getNrChannels() != outputLayout.getNrChannels() || inputLayout.getNrSamplesPerBatch() != outputLayout.getNrSamplesPerBatch() ) {
+    throw ObservationError("ERROR: impossible to convert between batches of different shape");
   }
-  inputFile.sync_with_stdio(false);
-  inputFile.seekg(bytesToSkip, std::ios::beg);
-  for ( unsigned int batch = 0; batch < observation.getNrBatches(); batch++ ) {
-    if ( inputBits >= 8 ) {
-      data.at(batch) = new std::vector<T>(observation.getNrChannels() * observation.getNrSamplesPerBatch(false, padding / sizeof(T)));
-      for ( unsigned int sample = 0; sample < observation.getNrSamplesPerBatch(); sample++ ) {
-        for ( unsigned int channel = observation.getNrChannels(); channel > 0; channel-- ) {
-          inputFile.read(buffer, BUFFER_DIM);
-          data.at(batch)->at((static_cast<uint64_t>(channel - 1) * observation.getNrSamplesPerBatch(false, padding / sizeof(T))) + sample) = *(reinterpret_cast<T *>(buffer));
-        }
+  checkScaleAndOffset(inputLayout.getNrChannels(), scale, offset);
+  readRawBatches(ConversionLayout<LI, LO>(inputLayout, outputLayout), observation, source, bytesToSkip + (static_cast<uint64_t>(firstBatch) * inputLayout.getNrInputBytesPerBatch()), data, [&](const uint8_t * input, O * output) {
+    ASTRODATA_TIMER(timer, InstrumentationPhase::Decode, inputLayout.getNrInputBytesPerBatch());
+    std::vector<float> samples(inputLayout.getNrSamplesPerBatch());
+
+    for ( unsigned int channel = 0; channel < inputLayout.getNrChannels(); channel++ ) {
+      loadSIGPROCChannel(inputLayout, input, channel, samples.data());
+      scaleChannel(inputLayout.getNrSamplesPerBatch(), scale, offset, channel, samples.data());
+      storeChannel(outputLayout, samples.data(), channel, output);
+    }
+  });
+}
+
+template<typename L> inline void loadSIGPROCChannel(const L & layout, const uint8_t * input, const unsigned int channel, float * samples) {
+  // Samples are stored time-major, from the highest to the lowest frequency channel
+  const unsigned int fileChannel = (layout.getNrChannels() - 1) - channel;
+  const uint8_t inputBits = layout.getNrInputBits();
+
+  if ( inputBits == 8 ) {
+    for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
+      samples[sample] = input[(static_cast<uint64_t>(sample) * layout.getNrChannels()) + fileChannel];
+    }
+  } else if ( inputBits == 16 ) {
+    for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
+      uint16_t value = 0;
+
+      std::memcpy(reinterpret_cast<void *>(&value), reinterpret_cast<const void *>(input + (((static_cast<uint64_t>(sample) * layout.getNrChannels()) + fileChannel) * 2)), 2);
+      samples[sample] = value;
+    }
+  } else if ( inputBits == 32 ) {
+    for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
+      std::memcpy(reinterpret_cast<void *>(samples + sample), reinterpret_cast<const void *>(input + (((static_cast<uint64_t>(sample) * layout.getNrChannels()) + fileChannel) * 4)), 4);
+    }
+  } else {
+    const unsigned int samplesPerByte = 8 / inputBits;
+    const uint8_t mask = static_cast<uint8_t>((1 << inputBits) - 1);
+
+    for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
+      const uint64_t item = (static_cast<uint64_t>(sample) * layout.getNrChannels()) + fileChannel;
+
+      samples[sample] = (input[item / samplesPerByte] >> ((item % samplesPerByte) * inputBits)) & mask;
+    }
+  }
+}
+
+template<typename T> void readMultiBeamSIGPROC(const Observation & observation, const unsigned int padding, const uint8_t inputBits, const unsigned int bytesToSkip, const std::vector<std::string> & inputFilenames, std::vector<std::vector<T> *> & data, const unsigned int firstBatch) {
+  readMultiBeamSIGPROC(BatchLayout<T>(observation, padding, inputBits), observation, bytesToSkip, inputFilenames, data, firstBatch);
+}
+
+template<typename T, typename L> void readMultiBeamSIGPROC(const L & layout, const Observation & observation, const unsigned int bytesToSkip, const std::vector<std::string> & inputFilenames, std::vector<std::vector<T> *> & data, const unsigned int firstBatch) {
+  std::vector<std::unique_ptr<ByteSource>> files;
+  std::vector<ByteSource *> sources;
+
+  for ( unsigned int beam = 0; beam < inputFilenames.size(); beam++ ) {
+    files.push_back(std::unique_ptr<ByteSource>(new PreadSource(inputFilenames.at(beam))));
+    sources.push_back(files.back().get());
+  }
+  readMultiBeamSIGPROC(layout, observation, sources, bytesToSkip, data, firstBatch);
+}
+
+template<typename T, typename L> void readMultiBeamSIGPROC(const L & layout, const Observation & observation, std::vector<ByteSource *> & sources, const uint64_t bytesToSkip, std::vector<std::vector<T> *> & data, const unsigned int firstBatch) {
+  readMultiBeamBatches(layout, observation, sources, bytesToSkip + (static_cast<uint64_t>(firstBatch) * layout.getNrInputBytesPerBatch()), data, [&layout](const uint8_t * input, T * output) {
+    unpackSIGPROC(layout, input, output);
+  });
+}
+
+template<typename T, typename L> void unpackSIGPROC(const L & layout, const uint8_t * input, T * output) {
+  if ( layout.getNrInputBits() >= 8 ) {
+    if ( layout.getNrInputBits() != sizeof(T) * 8 ) {
+      throw ObservationError("ERROR: samples of " + std::to_string(layout.getNrInputBits()) + " bits do not fit elements of " + std::to_string(sizeof(T) * 8) + " bits");
+    }
+    ASTRODATA_TIMER(timer, InstrumentationPhase::Transpose, layout.getNrInputBytesPerBatch());
+    // Samples are stored time-major, from the highest to the lowest frequency channel
+    const T * samples = reinterpret_cast<const T *>(input);
+
+    for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
+      const unsigned int fileChannel = (layout.getNrChannels() - 1) - channel;
+      T * channelOutput = output + layout.getIndex(channel, 0);
+
+      for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
+        channelOutput[sample] = samples[(static_cast<uint64_t>(sample) * layout.getNrChannels()) + fileChannel];
       }
-    } else {
-      uint64_t bytesToRead = static_cast<uint64_t>(observation.getNrSamplesPerBatch() * (observation.getNrChannels() / (8.0 / inputBits)));
-
-      data.at(batch) = new std::vector<T>(observation.getNrChannels() * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T)));
-      for ( uint64_t byte = 0; byte < bytesToRead; byte++ ) {
-        unsigned int channel = (observation.getNrChannels() - 1) - ((byte * (8 / inputBits)) % observation.getNrChannels());
-        unsigned int sample = (byte * (8 / inputBits)) / observation.getNrChannels();
-        unsigned int sampleByte = sample / (8 / inputBits);
-        uint8_t sampleFirstBit = (sample % (8 / inputBits)) * inputBits;
-
-        inputFile.read(buffer, BUFFER_DIM);
-        for ( unsigned int item = 0; item < 8 / inputBits; item++ ) {
-          uint8_t channelFirstBit = item * inputBits;
-          uint8_t sampleBuffer = 0;
-
-          if ( item > channel ) {
-            // All channels read, the remaining elements are from the next sample
-            unsigned int channelOffset = 0;
-            channel = (observation.getNrChannels() - 1);
-            sample += 1;
-            sampleByte = sample / (8 / inputBits);
-            sampleFirstBit = (sample % (8 / inputBits)) * inputBits;
-
-            while ( item < (8 / inputBits) ) {
-              channelFirstBit = item * inputBits;
-              sampleBuffer = data.at(batch)->at((static_cast<uint64_t>(channel - channelOffset) * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T))) + sampleByte);
-              for ( uint8_t bit = 0; bit < inputBits; bit++ ) {
-                isa::utils::setBit(sampleBuffer, isa::utils::getBit(*buffer, channelFirstBit + bit), sampleFirstBit + bit);
-              }
-              data.at(batch)->at((static_cast<uint64_t>(channel - channelOffset) * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T))) + sampleByte) = sampleBuffer;
-              item++;
-              channelOffset++;
-            }
-
-            break;
-          }
-          sampleBuffer = data.at(batch)->at((static_cast<uint64_t>(channel - item) * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T))) + sampleByte);
-          for ( uint8_t bit = 0; bit < inputBits; bit++ ) {
-            isa::utils::setBit(sampleBuffer, isa::utils::getBit(*buffer, channelFirstBit + bit), sampleFirstBit + bit);
-          }
-          data.at(batch)->at((static_cast<uint64_t>(channel - item) * isa::utils::pad(observation.getNrSamplesPerBatch() / (8 / inputBits), padding / sizeof(T))) + sampleByte) = sampleBuffer;
+    }
+  } else {
+    ASTRODATA_TIMER(timer, InstrumentationPhase::Decode, layout.getNrInputBytesPerBatch());
+    // Sub-byte samples are packed from the least significant bit, both in the file and in memory
+    const uint8_t inputBits = layout.getNrInputBits();
+    const unsigned int samplesPerByte = layout.getNrSamplesPerElement();
+    const uint8_t mask = (1 << inputBits) - 1;
+
+    for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
+      const unsigned int fileChannel = (layout.getNrChannels() - 1) - channel;
+      T * channelOutput = output + layout.getIndex(channel, 0);
+
+      for ( unsigned int byte = 0; byte < layout.getNrElementsPerChannel(); byte++ ) {
+        uint8_t value = 0;
+
+        for ( unsigned int item = 0; item < samplesPerByte; item++ ) {
+          uint64_t inputItem = (static_cast<uint64_t>((byte * samplesPerByte) + item) * layout.getNrChannels()) + fileChannel;
+          uint8_t sample = (input[inputItem / samplesPerByte] >> ((inputItem % samplesPerByte) * inputBits)) & mask;
+
+          value |= sample << (item * inputBits);
         }
+        channelOutput[byte] = static_cast<T>(value);
       }
     }
   }
-  inputFile.close();
-
-  delete [] buffer;
 }
 
 #ifdef HAVE_HDF5
+inline void readLOFARHeader(const std::string & headerFilename, Observation & observation, const unsigned int beam) {
+  const LOFARIndex index(headerFilename);
+  const Observation & beamObservation = index.getBeam(beam).observation;
+
+  observation.setNrBeams(beamObservation.getNrBeams());
+  observation.setNrStations(beamObservation.getNrStations());
+  observation.setNrSamplesPerBatch(beamObservation.getNrSamplesPerBatch());
+  observation.setNrBatches(beamObservation.getNrBatches());
+  observation.setFrequencyRange(1, beamObservation.getNrChannels(), beamObservation.getMinFreq(), beamObservation.getChannelBandwidth());
+}
+
+inline void appendLOFAR(ConcatenatedSource & source, Observation & observation, const std::string & headerFilename, const std::string & rawFilename) {
+  Observation fileObservation;
+
+  readLOFARHeader(headerFilename, fileObservation);
+  appendRawFile(source, observation, fileObservation, rawFilename, 0, 32);
+}
+
 template<typename T> void readLOFAR(std::string headerFilename, std::string rawFilename, Observation & observation, const unsigned int padding, std::vector<std::vector<T> *> & data, unsigned int nrBatches, unsigned int firstBatch) {
-  unsigned int nrSubbands, nrChannels;
-  float minFreq, channelBandwidth;
-  // Read the HDF5 file with the metadata
-  H5::H5File headerFile = H5::H5File(headerFilename, H5F_ACC_RDONLY);
-  H5::FloatType typeDouble = H5::FloatType(H5::PredType::NATIVE_DOUBLE);
-  double valueDouble = 0.0;
-  H5::IntType typeUInt = H5::IntType(H5::PredType::NATIVE_UINT);
-  unsigned int valueUInt = 0;
-
-  H5::Group currentNode = headerFile.openGroup("/");
-  currentNode.openAttribute("OBSERVATION_FREQUENCY_MIN").read(typeDouble, reinterpret_cast<void *>(&valueDouble));
-  minFreq = valueDouble;
-  currentNode = currentNode.openGroup(currentNode.getObjnameByIdx(0));
-  currentNode.openAttribute("TOTAL_INTEGRATION_TIME").read(typeDouble, reinterpret_cast<void *>(&valueDouble));
-  double totalIntegrationTime = valueDouble;
-  currentNode.openAttribute("NOF_BEAMS").read(typeUInt, reinterpret_cast<void *>(&valueUInt));
-  observation.setNrBeams(valueUInt);
-  currentNode = currentNode.openGroup(currentNode.getObjnameByIdx(0));
-  currentNode.openAttribute("NOF_SAMPLES").read(typeUInt, reinterpret_cast<void *>(&valueUInt));
-  unsigned int totalSamples = valueUInt;
-  currentNode.openAttribute("NOF_STATIONS").read(typeUInt, reinterpret_cast<void *>(&valueUInt));
-  observation.setNrStations(valueUInt);
-  currentNode.openAttribute("CHANNELS_PER_SUBBAND").read(typeUInt, reinterpret_cast<void *>(&valueUInt));
-  nrChannels = valueUInt;
-  currentNode.openAttribute("CHANNEL_WIDTH").read(typeDouble, reinterpret_cast<void *>(&valueDouble));
-  channelBandwidth = valueDouble / 1000000;
-  H5::DataSet currentData = currentNode.openDataSet("STOKES_0");
-  currentData.openAttribute("NOF_SUBBANDS").read(typeUInt, reinterpret_cast<void *>(&valueUInt));
-  nrSubbands = valueUInt;
-  headerFile.close();
-
-  observation.setNrSamplesPerBatch(static_cast<unsigned int>(totalSamples / totalIntegrationTime));
-  if ( nrBatches == 0 ) {
-    observation.setNrBatches(static_cast<unsigned int>(totalIntegrationTime));
-  } else {
-    if ( static_cast<unsigned int>(totalIntegrationTime) >= (firstBatch + nrBatches) ) {
+  readLOFARHeader(headerFilename, observation);
+  const unsigned int totalIntegrationTime = observation.getNrBatches();
+
+  if ( nrBatches != 0 ) {
+    if ( totalIntegrationTime >= (firstBatch + nrBatches) ) {
       observation.setNrBatches(nrBatches);
     } else {
-      observation.setNrBatches(static_cast<unsigned int>(totalIntegrationTime) - firstBatch);
+      observation.setNrBatches(totalIntegrationTime - firstBatch);
     }
   }
-  observation.setFrequencyRange(1, nrSubbands * nrChannels, minFreq, channelBandwidth);
 
   // Read the raw file with the actual data
-  std::ifstream rawFile;
-  rawFile.open(rawFilename.c_str(), std::ios::binary);
-  if ( !rawFile ) {
-    throw FileError("Impossible to open " + rawFilename);
+  data.resize(observation.getNrBatches());
+  readLOFAR(BatchLayout<T>(observation, padding, 32), observation, rawFilename, data, firstBatch);
+}
+
+template<typename T> void readMultiBeamLOFAR(const std::vector<std::string> & headerFilenames, const std::vector<std::string> & rawFilenames, Observation & observation, const unsigned int padding, std::vector<std::vector<T> *> & data, unsigned int nrBatches, unsigned int firstBatch) {
+  std::vector<std::unique_ptr<ByteSource>> files;
+  std::vector<ByteSource *> sources;
+
+  if ( headerFilenames.empty() || headerFilenames.size() != rawFilenames.size() ) {
+    throw FileError("ERROR: multi-beam LOFAR data needs one header and one raw file per beam");
   }
-  rawFile.sync_with_stdio(false);
-  if ( firstBatch > 0 ) {
-    rawFile.seekg(firstBatch * observation.getNrSamplesPerBatch() * nrSubbands * nrChannels, std::ios::beg);
+  readLOFARHeader(headerFilenames.at(0), observation);
+  for ( unsigned int beam = 1; beam < headerFilenames.size(); beam++ ) {
+    Observation beamObservation;
+
+    readLOFARHeader(headerFilenames.at(beam), beamObservation);
+    if ( beamObservation.getLayoutHash() != observation.getLayoutHash() || beamObservation.getNrBatches() != observation.getNrBatches() || beamObservation.getMinFreq() != observation.getMinFreq() || beamObservation.getChannelBandwidth() != observation.getChannelBandwidth() ) {
+      throw ObservationError("ERROR: the header \"" + headerFilenames.at(beam) + "\" does not match the other beams");
+    }
+  }
+  observation.setNrBeams(headerFilenames.size());
+  if ( nrBatches != 0 ) {
+    if ( observation.getNrBatches() >= (firstBatch + nrBatches) ) {
+      observation.setNrBatches(nrBatches);
+    } else {
+      observation.setNrBatches(observation.getNrBatches() - firstBatch);
+    }
+  }
+  for ( unsigned int beam = 0; beam < rawFilenames.size(); beam++ ) {
+    files.push_back(std::unique_ptr<ByteSource>(new PreadSource(rawFilenames.at(beam))));
+    sources.push_back(files.back().get());
   }
   data.resize(observation.getNrBatches());
+  readMultiBeamLOFAR(BatchLayout<T>(observation, padding, 32), observation, sources, data, firstBatch);
+}
+
+template<typename T, typename L> void readMultiBeamLOFAR(const L & layout, const Observation & observation, std::vector<ByteSource *> & sources, std::vector<std::vector<T> *> & data, const unsigned int firstBatch) {
+  readMultiBeamBatches(layout, observation, sources, static_cast<uint64_t>(firstBatch) * layout.getNrInputBytesPerBatch(), data, [&layout](const uint8_t * input, T * output) {
+    unpackLOFAR(layout, input, output);
+  });
+}
+
+template<typename T, typename L> void readLOFAR(const L & layout, const Observation & observation, const std::string & rawFilename, std::vector<std::vector<T> *> & data, const unsigned int firstBatch, const NUMAPolicy & policy) {
+  PreadSource source(rawFilename);
+
+  readLOFAR(layout, observation, source, data, firstBatch, policy);
+}
+
+template<typename T, typename L> void readLOFAR(const L & layout, const Observation & observation, ByteSource & source, std::vector<std::vector<T> *> & data, const unsigned int firstBatch, const NUMAPolicy & policy) {
+  readRawBatches(layout, observation, source, static_cast<uint64_t>(firstBatch) * layout.getNrInputBytesPerBatch(), data, [&layout](const uint8_t * input, T * output) {
+    unpackLOFAR(layout, input, output);
+  }, policy);
+}
+
+template<typename T, typename L> void unpackLOFAR(const L & layout, const uint8_t * input, T * output) {
+  ASTRODATA_TIMER(timer, InstrumentationPhase::Transpose, layout.getNrInputBytesPerBatch());
+  // Samples are stored time-major, as big endian 32 bit words
+  for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
+    T * channelOutput = output + layout.getIndex(channel, 0);
 
-  char * word = new char [4];
+    for ( unsigned int sample = 0; sample < layout.getNrSamplesPerBatch(); sample++ ) {
+      char word[4];
+
+      std::memcpy(reinterpret_cast<void *>(word), reinterpret_cast<const void *>(input + (((static_cast<uint64_t>(sample) * layout.getNrChannels()) + channel) * 4)), 4);
+      isa::utils::bigEndianToLittleEndian(word);
+      channelOutput[sample] = *(reinterpret_cast<T *>(word));
+    }
+  }
+}
+#endif // HAVE_HDF5
+
+template<typename T, typename L, typename U> void readRawBatches(const L & layout, const Observation & observation, ByteSource & source, const uint64_t offset, std::vector<std::vector<T> *> & data, U unpack, const NUMAPolicy & policy) {
+  // Double buffering: the next batch is read while the current one is unpacked
+  std::vector<uint8_t> buffers[2];
+
+  if ( observation.getNrBatches() == 0 ) {
+    return;
+  }
+  if ( offset + (observation.getNrBatches() * layout.getNrInputBytesPerBatch()) > source.getSize() ) {
+    throw FileError("ERROR: input is too short for " + std::to_string(observation.getNrBatches()) + " batches");
+  }
+  if ( policy.mode != NUMAMode::Default ) {
+    readRawBatchesNUMA(layout, observation, source, offset, data, unpack, policy);
+    return;
+  }
+  buffers[0].resize(layout.getNrInputBytesPerBatch());
+  buffers[1].resize(layout.getNrInputBytesPerBatch());
+  source.submit(ReadRequest{offset, layout.getNrInputBytesPerBatch(), buffers[0].data()});
   for ( unsigned int batch = 0; batch < observation.getNrBatches(); batch++ ) {
-    data.at(batch) = new std::vector<T>(observation.getNrChannels() * observation.getNrSamplesPerBatch(false, padding / sizeof(T)));
-    for ( unsigned int sample = 0; sample < observation.getNrSamplesPerBatch(); sample++ ) {
-      for ( unsigned int subband = 0; subband < nrSubbands; subband++ ) {
-        for ( unsigned int channel = 0; channel < nrChannels; channel++ ) {
-          unsigned int globalChannel = (subband * nrChannels) + channel;
-
-          rawFile.read(word, 4);
-          isa::utils::bigEndianToLittleEndian(word);
-          data.at(batch)->at((globalChannel * observation.getNrSamplesPerBatch(false, padding / sizeof(T))) + sample) = *(reinterpret_cast<T *>(word));
+    {
+      ASTRODATA_TIMER(timer, InstrumentationPhase::Read, layout.getNrInputBytesPerBatch());
+      source.wait();
+      if ( batch + 1 < observation.getNrBatches() ) {
+        source.submit(ReadRequest{offset + ((batch + 1) * layout.getNrInputBytesPerBatch()), layout.getNrInputBytesPerBatch(), buffers[(batch + 1) % 2].data()});
+      }
+    }
+    try {
+      {
+        ASTRODATA_TIMER(timer, InstrumentationPhase::Allocate, layout.getNrBytesPerBatch());
+        data.at(batch) = new std::vector<T>(layout.getNrElementsPerBatch());
+      }
+      unpack(buffers[batch % 2].data(), data.at(batch)->data());
+    } catch ( ... ) {
+      // Do not release the buffers while a read is still in flight
+      source.wait();
+      throw;
+    }
+  }
+}
+
+template<typename T, typename L, typename U> void readRawBatchesNUMA(const L & layout, const Observation & observation, ByteSource & source, const uint64_t offset, std::vector<std::vector<T> *> & data, U unpack, const NUMAPolicy & policy) {
+  // One raw buffer per thread; each group of batches is read, then allocated and unpacked in parallel
+#ifdef _OPENMP
+  const unsigned int nrBuffers = std::min(static_cast<unsigned int>(omp_get_max_threads()), observation.getNrBatches());
+#else
+  const unsigned int nrBuffers = 1;
+#endif // _OPENMP
+  std::vector<std::vector<uint8_t>> buffers(nrBuffers, std::vector<uint8_t>(layout.getNrInputBytesPerBatch()));
+
+  for ( unsigned int firstBatch = 0; firstBatch < observation.getNrBatches(); firstBatch += nrBuffers ) {
+    const unsigned int nrGroupBatches = std::min(nrBuffers, observation.getNrBatches() - firstBatch);
+    std::exception_ptr error;
+
+    {
+      ASTRODATA_TIMER(timer, InstrumentationPhase::Read, static_cast<uint64_t>(nrGroupBatches) * layout.getNrInputBytesPerBatch());
+      for ( unsigned int batch = 0; batch < nrGroupBatches; batch++ ) {
+        source.submit(ReadRequest{offset + ((static_cast<uint64_t>(firstBatch) + batch) * layout.getNrInputBytesPerBatch()), layout.getNrInputBytesPerBatch(), buffers.at(batch).data()});
+      }
+      source.wait();
+    }
+    #pragma omp parallel for schedule(static, 1)
+    for ( unsigned int batch = 0; batch < nrGroupBatches; batch++ ) {
+      const unsigned int node = getPolicyNode(policy, firstBatch + batch);
+      ScopedAffinity affinity;
+
+      try {
+        // Pages are placed by the first touch of the pinned thread; the heap storage of a vector shares pages with other allocations, so it is not moved with mbind
+        pinThreadToNode(node);
+        {
+          ASTRODATA_TIMER(timer, InstrumentationPhase::Allocate, layout.getNrBytesPerBatch());
+          data.at(firstBatch + batch) = new std::vector<T>(layout.getNrElementsPerBatch());
         }
+        unpack(buffers.at(batch).data(), data.at(firstBatch + batch)->data());
+      } catch ( ... ) {
+        #pragma omp critical
+        error = std::current_exception();
       }
     }
+    if ( error ) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+template<typename T, typename L, typename U> void readMultiBeamBatches(const L & layout, const Observation & observation, std::vector<ByteSource *> & sources, const uint64_t offset, std::vector<std::vector<T> *> & data, U unpack) {
+  const unsigned int nrBeams = sources.size();
+  const unsigned int nrBatches = observation.getNrBatches();
+  // Reads from one source are serialized, decoding is not
+  std::vector<std::mutex> sourceLocks(nrBeams);
+  std::exception_ptr error;
+  std::atomic<bool> failed(false);
+
+  if ( nrBeams != observation.getNrBeams() ) {
+    throw ObservationError("ERROR: " + std::to_string(nrBeams) + " sources for " + std::to_string(observation.getNrBeams()) + " beams");
+  }
+  for ( unsigned int beam = 0; beam < nrBeams; beam++ ) {
+    if ( offset + (nrBatches * layout.getNrInputBytesPerBatch()) > sources.at(beam)->getSize() ) {
+      throw FileError("ERROR: input of beam " + std::to_string(beam) + " is too short for " + std::to_string(nrBatches) + " batches");
+    }
+  }
+  #pragma omp parallel
+  {
+    std::vector<uint8_t> buffer(layout.getNrInputBytesPerBatch());
+
+    #pragma omp for schedule(static)
+    for ( unsigned int batch = 0; batch < nrBatches; batch++ ) {
+      try {
+        ASTRODATA_TIMER(timer, InstrumentationPhase::Allocate, nrBeams * layout.getNrBytesPerBatch());
+        data.at(batch) = new std::vector<T>(nrBeams * layout.getNrElementsPerBatch());
+      } catch ( ... ) {
+        #pragma omp critical
+        error = std::current_exception();
+        failed = true;
+      }
+    }
+    #pragma omp for collapse(2) schedule(dynamic)
+    for ( unsigned int beam = 0; beam < nrBeams; beam++ ) {
+      for ( unsigned int batch = 0; batch < nrBatches; batch++ ) {
+        if ( failed ) {
+          continue;
+        }
+        try {
+          {
+            std::lock_guard<std::mutex> lock(sourceLocks.at(beam));
+            ASTRODATA_TIMER(timer, InstrumentationPhase::Read, layout.getNrInputBytesPerBatch());
+
+            sources.at(beam)->read(offset + (static_cast<uint64_t>(batch) * layout.getNrInputBytesPerBatch()), layout.getNrInputBytesPerBatch(), buffer.data());
+          }
+          unpack(buffer.data(), data.at(batch)->data() + (beam * layout.getNrElementsPerBatch()));
+        } catch ( ... ) {
+          #pragma omp critical
+          error = std::current_exception();
+          failed = true;
+        }
+      }
+    }
+  }
+  if ( error ) {
+    std::rethrow_exception(error);
   }
-  rawFile.close();
-  delete [] word;
 }
-#endif // HAVE_HDF5
 
 #ifdef HAVE_PSRDADA
 template<typename T> inline void readPSRDADA(dada_hdu_t & ringBuffer, std::vector<T> * data) {
@@ -223,7 +495,10 @@ template<typename T> inline void readPSRDADA(dada_hdu_t & ringBuffer, std::vecto
   if ( (buffer == 0) || (bufferBytes == 0) ) {
     throw RingBufferError("ERROR: impossible to read the PSRDADA buffer");
   }
-  std::memcpy(reinterpret_cast<void *>(data->data()), reinterpret_cast<const void *>(buffer), data->size() * sizeof(T));
+  {
+    ASTRODATA_TIMER(timer, InstrumentationPhase::Read, data->size() * sizeof(T));
+    std::memcpy(reinterpret_cast<void *>(data->data()), reinterpret_cast<const void *>(buffer), data->size() * sizeof(T));
+  }
   if ( ipcbuf_mark_cleared(reinterpret_cast< ipcbuf_t * >(ringBuffer.data_block)) < 0 ) {
     throw RingBufferError("ERROR: impossible to mark the PSRDADA buffer as cleared");
   }
@@ -0,0 +1,103 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+
+
+#pragma once
+
+namespace AstroData {
+
+// Round value up to a multiple of padding, no padding if zero
+constexpr unsigned int staticPad(const unsigned int value, const unsigned int padding) {
+  return (padding == 0) ? value : (((value + padding - 1) / padding) * padding);
+}
+
+// Batch layout known at compile time; Padding is in bytes, sub-byte samples are packed in uint8_t
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> class StaticLayout {
+public:
+  static_assert(Bits == 1 || Bits == 2 || Bits == 4 || Bits == 8 || Bits == 16 || Bits == 32, "unsupported number of bits per sample");
+  static_assert(Bits >= 8 || (Samples % (8 / Bits)) == 0, "samples per batch must fill whole bytes");
+
+  constexpr unsigned int getNrChannels() const;
+  constexpr unsigned int getNrSamplesPerBatch() const;
+  constexpr uint8_t getNrInputBits() const;
+  // Size in bytes of one element of the batch buffer
+  constexpr unsigned int getElementSize() const;
+  // Number of samples packed in one element
+  constexpr unsigned int getNrSamplesPerElement() const;
+  constexpr unsigned int getNrElementsPerChannel() const;
+  // Padded distance, in elements, between two channels
+  constexpr unsigned int getChannelStride() const;
+  constexpr uint64_t getNrElementsPerBatch() const;
+  constexpr uint64_t getNrBytesPerBatch() const;
+  // Size in bytes of one batch in the input file
+  constexpr uint64_t getNrInputBytesPerBatch() const;
+  constexpr uint64_t getIndex(const unsigned int channel, const unsigned int element) const;
+  // Padded distance between two synthesized beams in the beam mapping
+  constexpr unsigned int getBeamMappingStride() const;
+};
+
+// Implementations
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr unsigned int StaticLayout<Channels, Samples, Padding, Bits>::getNrChannels() const {
+  return Channels;
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr unsigned int StaticLayout<Channels, Samples, Padding, Bits>::getNrSamplesPerBatch() const {
+  return Samples;
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr uint8_t StaticLayout<Channels, Samples, Padding, Bits>::getNrInputBits() const {
+  return Bits;
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr unsigned int StaticLayout<Channels, Samples, Padding, Bits>::getElementSize() const {
+  return (Bits < 8) ? 1 : Bits / 8;
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr unsigned int StaticLayout<Channels, Samples, Padding, Bits>::getNrSamplesPerElement() const {
+  return (Bits < 8) ? 8 / Bits : 1;
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr unsigned int StaticLayout<Channels, Samples, Padding, Bits>::getNrElementsPerChannel() const {
+  return Samples / getNrSamplesPerElement();
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr unsigned int StaticLayout<Channels, Samples, Padding, Bits>::getChannelStride() const {
+  return staticPad(getNrElementsPerChannel(), Padding / getElementSize());
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr uint64_t StaticLayout<Channels, Samples, Padding, Bits>::getNrElementsPerBatch() const {
+  return static_cast<uint64_t>(Channels) * getChannelStride();
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr uint64_t StaticLayout<Channels, Samples, Padding, Bits>::getNrBytesPerBatch() const {
+  return getNrElementsPerBatch() * getElementSize();
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr uint64_t StaticLayout<Channels, Samples, Padding, Bits>::getNrInputBytesPerBatch() const {
+  return (static_cast<uint64_t>(Channels) * Samples * Bits) / 8;
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr uint64_t StaticLayout<Channels, Samples, Padding, Bits>::getIndex(const unsigned int channel, const unsigned int element) const {
+  return (static_cast<uint64_t>(channel) * getChannelStride()) + element;
+}
+
+template<unsigned int Channels, unsigned int Samples, unsigned int Padding, unsigned int Bits> constexpr unsigned int StaticLayout<Channels, Samples, Padding, Bits>::getBeamMappingStride() const {
+  return staticPad(Channels, Padding / sizeof(unsigned int));
+}
+
+} // AstroData
+
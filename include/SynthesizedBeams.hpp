@@ -15,9 +15,12 @@
 
 #include <vector>
 #include <string>
+#include <fstream>
 
 #include <Observation.hpp>
 #include <Platform.hpp>
+#include <StaticLayout.hpp>
+#include <BatchLayout.hpp>
 
 
 #pragma once
@@ -27,5 +30,34 @@ namespace AstroData {
 void generateBeamMapping(const AstroData::Observation & observation, std::vector<unsigned int> & beamMapping, const unsigned int padding, const bool subbanding = false);
 // Read beam mapping file
 void readBeamMapping(const AstroData::Observation & observation, const std::string & inputFilename, std::vector<unsigned int> & beamMapping, const unsigned int padding, const bool subbanding = false);
+// Beam mapping with a batch layout (e.g. StaticLayout)
+template<typename L> void generateBeamMapping(const L & layout, const AstroData::Observation & observation, std::vector<unsigned int> & beamMapping);
+template<typename L> void readBeamMapping(const L & layout, const AstroData::Observation & observation, const std::string & inputFilename, std::vector<unsigned int> & beamMapping);
+
+// Implementations
+template<typename L> void generateBeamMapping(const L & layout, const AstroData::Observation & observation, std::vector<unsigned int> & beamMapping) {
+  for ( unsigned int beam = 0; beam < observation.getNrSynthesizedBeams(); beam++ ) {
+    const unsigned int mappedBeam = beam % observation.getNrBeams();
+
+    for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
+      beamMapping[(beam * layout.getBeamMappingStride()) + channel] = mappedBeam;
+    }
+  }
+}
+
+template<typename L> void readBeamMapping(const L & layout, const AstroData::Observation & observation, const std::string & inputFilename, std::vector<unsigned int> & beamMapping) {
+  std::ifstream inputFile;
+
+  inputFile.open(inputFilename);
+  if ( !inputFile ) {
+    throw FileError("Impossible to open " + inputFilename);
+  }
+  for ( unsigned int sBeam = 0; sBeam < observation.getNrSynthesizedBeams(); sBeam++ ) {
+    for ( unsigned int channel = 0; channel < layout.getNrChannels(); channel++ ) {
+      inputFile >> beamMapping[(sBeam * layout.getBeamMappingStride()) + channel];
+    }
+  }
+  inputFile.close();
+}
 } // AstroData
 
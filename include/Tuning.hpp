@@ -0,0 +1,63 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Observation.hpp"
+#include "Platform.hpp"
+
+
+#pragma once
+
+namespace AstroData {
+
+// Data or unified cache
+struct CacheInfo {
+  unsigned int level;
+  uint64_t size;
+  unsigned int lineSize;
+  unsigned int ways;
+};
+
+// Features of the host CPU
+struct CPUInfo {
+  std::string model;
+  // Widest vector unit, in bytes
+  unsigned int vectorWidth;
+  unsigned int cacheLineSize;
+  std::vector<CacheInfo> caches;
+};
+
+// Padding candidate and the time, in seconds, of one pass of the tuned kernels over all batches
+struct TuningResult {
+  unsigned int padding;
+  double time;
+};
+
+// Detect the host CPU from /proc/cpuinfo and sysfs
+CPUInfo getCPUInfo();
+// Key for the configuration files, from the CPU model (e.g. "Intel_R_Xeon_R_Gold_6130_CPU_2_10GHz")
+std::string getDeviceName(const CPUInfo & cpu);
+// Multiples of the vector width up to a page, and odd multiples of the cache line, in bytes
+std::vector<unsigned int> getCandidatePaddings(const CPUInfo & cpu);
+// Time the transpose (8 bit SIGPROC), unpack (2 bit to float) and beam mapping kernels for the observation with every padding; fastest first
+std::vector<TuningResult> tunePadding(const Observation & observation, const std::vector<unsigned int> & paddings, const double minTime = 0.1);
+// Set the value of a device in a "device value" file, as read by readPaddingConf and readVectorWidthConf; other lines are kept
+void writeDeviceConf(const std::string & filename, const std::string & deviceName, const unsigned int value);
+
+} // AstroData
+
@@ -0,0 +1,136 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <Bandpass.hpp>
+
+namespace {
+
+// Median of values, which are reordered
+float median(float * values, const unsigned int nrValues) {
+  std::nth_element(values, values + (nrValues / 2), values + nrValues);
+  float middle = values[nrValues / 2];
+
+  if ( nrValues % 2 == 0 ) {
+    middle = (middle + *std::max_element(values, values + (nrValues / 2))) / 2.0f;
+  }
+  return middle;
+}
+
+} // namespace
+
+namespace AstroData {
+
+Bandpass::Bandpass(const unsigned int nrChannels, const unsigned int window, const BandpassEstimator estimator, const std::vector<unsigned int> & zappedChannels, const float clipping) : nrChannels(nrChannels), window(std::max(window, 1u)), estimator(estimator), clipping(clipping), zapped(nrChannels, 0), nrBatches(0), baseline(nrChannels, 0.0f), scale(nrChannels, 1.0f) {
+  for ( unsigned int channel = 0; channel < std::min(nrChannels, static_cast<unsigned int>(zappedChannels.size())); channel++ ) {
+    zapped.at(channel) = zappedChannels.at(channel) != 0;
+  }
+  locations.resize(static_cast<uint64_t>(this->window) * nrChannels);
+  spreads.resize(static_cast<uint64_t>(this->window) * nrChannels);
+}
+
+Bandpass::~Bandpass() {}
+
+void Bandpass::getScaleAndOffset(std::vector<float> & channelScale, std::vector<float> & channelOffset, const float targetScale, const float targetOffset) const {
+  channelScale.resize(nrChannels);
+  channelOffset.resize(nrChannels);
+  for ( unsigned int channel = 0; channel < nrChannels; channel++ ) {
+    if ( zapped.at(channel) ) {
+      channelScale.at(channel) = 1.0f;
+      channelOffset.at(channel) = 0.0f;
+    } else {
+      channelScale.at(channel) = targetScale / scale.at(channel);
+      channelOffset.at(channel) = targetOffset - (baseline.at(channel) * channelScale.at(channel));
+    }
+  }
+}
+
+void Bandpass::estimate(float * samples, const unsigned int nrSamples, float & location, float & spread) const {
+  location = 0.0f;
+  spread = 0.0f;
+  if ( nrSamples == 0 ) {
+    return;
+  }
+  if ( estimator == BandpassEstimator::Median ) {
+    location = median(samples, nrSamples);
+    #pragma omp simd
+    for ( unsigned int sample = 0; sample < nrSamples; sample++ ) {
+      samples[sample] = std::fabs(samples[sample] - location);
+    }
+    // Median absolute deviation of a normal distribution
+    spread = 1.4826f * median(samples, nrSamples);
+  } else {
+    float lower = -std::numeric_limits<float>::max();
+    float upper = std::numeric_limits<float>::max();
+
+    for ( unsigned int iteration = 0; iteration < 4; iteration++ ) {
+      double sum = 0.0;
+      double squares = 0.0;
+      unsigned int nrUsed = 0;
+
+      #pragma omp simd reduction(+:sum,squares,nrUsed)
+      for ( unsigned int sample = 0; sample < nrSamples; sample++ ) {
+        const bool used = samples[sample] >= lower && samples[sample] <= upper;
+        const double value = used ? samples[sample] : 0.0;
+
+        sum += value;
+        squares += value * value;
+        nrUsed += used ? 1 : 0;
+      }
+      if ( nrUsed == 0 ) {
+        break;
+      }
+      location = sum / nrUsed;
+      spread = std::sqrt(std::max(0.0, (squares / nrUsed) - (static_cast<double>(location) * location)));
+      lower = location - (clipping * spread);
+      upper = location + (clipping * spread);
+    }
+  }
+}
+
+void Bandpass::updateModel(const unsigned int channel) {
+  const unsigned int nrUsed = getNrBatches();
+  std::vector<float> channelLocations(nrUsed);
+  std::vector<float> channelSpreads(nrUsed);
+
+  for ( unsigned int batch = 0; batch < nrUsed; batch++ ) {
+    channelLocations.at(batch) = locations.at((batch * nrChannels) + channel);
+    channelSpreads.at(batch) = spreads.at((batch * nrChannels) + channel);
+  }
+  if ( estimator == BandpassEstimator::Median ) {
+    baseline.at(channel) = median(channelLocations.data(), nrUsed);
+    scale.at(channel) = median(channelSpreads.data(), nrUsed);
+  } else {
+    float locationSum = 0.0f;
+    float spreadSum = 0.0f;
+
+    for ( unsigned int batch = 0; batch < nrUsed; batch++ ) {
+      locationSum += channelLocations.at(batch);
+      spreadSum += channelSpreads.at(batch);
+    }
+    baseline.at(channel) = locationSum / nrUsed;
+    scale.at(channel) = spreadSum / nrUsed;
+  }
+  // Constant channels are only shifted
+  if ( scale.at(channel) <= 0.0f ) {
+    scale.at(channel) = 1.0f;
+  }
+}
+
+} // AstroData
+
@@ -0,0 +1,281 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <exception>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include <Configuration.hpp>
+
+namespace {
+
+const char blobMagic[8] = {'A', 'D', 'C', 'O', 'N', 'F', '\0', '\1'};
+
+// Call store(value, line) for every whitespace separated value
+template<typename F> void parseValues(const char * text, const uint64_t size, const std::string & filename, F store) {
+  const char * position = text;
+  const char * end = text + size;
+  unsigned int line = 1;
+
+  while ( position < end ) {
+    if ( *position == '\n' ) {
+      line++;
+      position++;
+    } else if ( std::isspace(static_cast<unsigned char>(*position)) ) {
+      position++;
+    } else if ( *position == '#' ) {
+      position = std::find(position, end, '\n');
+    } else {
+      unsigned int value = 0;
+
+      if ( !AstroData::parseUnsigned(position, end, value) || (position < end && !std::isspace(static_cast<unsigned char>(*position)) && *position != '#') ) {
+        throw AstroData::FileError("ERROR: malformed value at line " + std::to_string(line) + " of \"" + filename + "\"");
+      }
+      store(value, line);
+    }
+  }
+}
+
+// Any non-zero entry of a zapped channels vector is zapped
+bool isZapped(const unsigned int value) {
+  return value != 0;
+}
+
+void writeValue(std::ofstream & output, const uint32_t value) {
+  output.write(reinterpret_cast<const char *>(&value), sizeof(uint32_t));
+}
+
+void writeDeviceConf(std::ofstream & output, const std::map<std::string, unsigned int> & values) {
+  for ( auto item = values.begin(); item != values.end(); ++item ) {
+    writeValue(output, item->first.size());
+    output.write(item->first.data(), item->first.size());
+    writeValue(output, item->second);
+  }
+}
+
+// Bounds checked reads from a blob
+class BlobReader {
+public:
+  BlobReader(const char * data, const uint64_t size, const std::string & filename) : position(data), end(data + size), filename(filename) {}
+
+  void read(void * destination, const uint64_t bytes) {
+    if ( static_cast<uint64_t>(end - position) < bytes ) {
+      throw AstroData::FileError("ERROR: configuration blob \"" + filename + "\" is truncated");
+    }
+    std::memcpy(destination, position, bytes);
+    position += bytes;
+  }
+
+  uint32_t readValue() {
+    uint32_t value = 0;
+
+    read(&value, sizeof(uint32_t));
+    return value;
+  }
+
+  void readDeviceConf(const uint32_t nrValues, std::map<std::string, unsigned int> & values) {
+    for ( uint32_t item = 0; item < nrValues; item++ ) {
+      std::string name(readValue(), '\0');
+
+      read(&name[0], name.size());
+      values[name] = readValue();
+    }
+  }
+
+private:
+  const char * position;
+  const char * end;
+  std::string filename;
+};
+
+} // namespace
+
+namespace AstroData {
+
+void readZappedChannels(Observation & observation, const std::string & inputFilename, std::vector<unsigned int> & zappedChannels) {
+  unsigned int nrChannels = 0;
+  MappedFile input(inputFilename, "zapped channels");
+
+  if ( zappedChannels.size() < observation.getNrChannels() ) {
+    zappedChannels.resize(observation.getNrChannels());
+  }
+  parseZappedChannels(input.getData(), input.getSize(), inputFilename, observation.getNrChannels(), zappedChannels, nrChannels);
+  observation.setNrZappedChannels(nrChannels);
+}
+
+void readIntegrationSteps(const Observation & observation, const std::string  & inputFilename, std::set<unsigned int> & integrationSteps) {
+  MappedFile input(inputFilename, "integration steps");
+
+  parseIntegrationSteps(input.getData(), input.getSize(), inputFilename, observation.getNrSamplesPerBatch(), integrationSteps);
+}
+
+void parseZappedChannels(const char * text, const uint64_t size, const std::string & filename, const unsigned int nrChannels, std::vector<unsigned int> & zappedChannels, unsigned int & nrZappedChannels) {
+  parseValues(text, size, filename, [&](const unsigned int channel, const unsigned int line) {
+    if ( channel >= nrChannels ) {
+      throw FileError("ERROR: channel " + std::to_string(channel) + " at line " + std::to_string(line) + " of \"" + filename + "\" is not in the observation");
+    }
+    zappedChannels.at(channel) = 1;
+  });
+  nrZappedChannels = std::count_if(zappedChannels.begin(), zappedChannels.begin() + nrChannels, isZapped);
+}
+
+void parseIntegrationSteps(const char * text, const uint64_t size, const std::string & filename, const unsigned int nrSamplesPerBatch, std::set<unsigned int> & integrationSteps) {
+  parseValues(text, size, filename, [&](const unsigned int step, const unsigned int line) {
+    if ( step >= nrSamplesPerBatch ) {
+      throw FileError("ERROR: integration step " + std::to_string(step) + " at line " + std::to_string(line) + " of \"" + filename + "\" is not smaller than the batch");
+    }
+    integrationSteps.insert(step);
+  });
+}
+
+void readConfiguration(Observation & observation, const std::string & paddingFilename, const std::string & vectorFilename, const std::string & zappedChannelsFilename, const std::string & integrationStepsFilename, Configuration & configuration) {
+  unsigned int nrZappedChannels = 0;
+  std::exception_ptr errors[4];
+
+  configuration.zappedChannels.assign(observation.getNrChannels(), 0);
+  // Most of the time goes in opening files, so they are opened concurrently
+  #pragma omp parallel sections
+  {
+    #pragma omp section
+    {
+      try {
+        if ( !paddingFilename.empty() ) {
+          readPaddingConf(configuration.padding, paddingFilename);
+        }
+      } catch ( ... ) {
+        errors[0] = std::current_exception();
+      }
+    }
+    #pragma omp section
+    {
+      try {
+        if ( !vectorFilename.empty() ) {
+          readVectorWidthConf(configuration.vectorWidth, vectorFilename);
+        }
+      } catch ( ... ) {
+        errors[1] = std::current_exception();
+      }
+    }
+    #pragma omp section
+    {
+      try {
+        if ( !zappedChannelsFilename.empty() ) {
+          MappedFile input(zappedChannelsFilename, "zapped channels");
+
+          parseZappedChannels(input.getData(), input.getSize(), zappedChannelsFilename, observation.getNrChannels(), configuration.zappedChannels, nrZappedChannels);
+        }
+      } catch ( ... ) {
+        errors[2] = std::current_exception();
+      }
+    }
+    #pragma omp section
+    {
+      try {
+        if ( !integrationStepsFilename.empty() ) {
+          readIntegrationSteps(observation, integrationStepsFilename, configuration.integrationSteps);
+        }
+      } catch ( ... ) {
+        errors[3] = std::current_exception();
+      }
+    }
+  }
+  for ( unsigned int file = 0; file < 4; file++ ) {
+    if ( errors[file] ) {
+      std::rethrow_exception(errors[file]);
+    }
+  }
+  observation.setNrZappedChannels(nrZappedChannels);
+}
+
+void writeConfigurationBlob(const Observation & observation, const Configuration & configuration, const std::string & filename) {
+  std::ofstream output(filename, std::ios::binary);
+  const unsigned int nrChannels = std::min(observation.getNrChannels(), static_cast<unsigned int>(configuration.zappedChannels.size()));
+
+  if ( !output ) {
+    throw FileError("ERROR: impossible to open configuration blob \"" + filename + "\"");
+  }
+  output.write(blobMagic, sizeof(blobMagic));
+  writeValue(output, observation.getNrChannels());
+  writeValue(output, observation.getNrSamplesPerBatch());
+  writeValue(output, configuration.padding.size());
+  writeValue(output, configuration.vectorWidth.size());
+  writeValue(output, std::count_if(configuration.zappedChannels.begin(), configuration.zappedChannels.begin() + nrChannels, isZapped));
+  writeValue(output, configuration.integrationSteps.size());
+  writeDeviceConf(output, configuration.padding);
+  writeDeviceConf(output, configuration.vectorWidth);
+  for ( unsigned int channel = 0; channel < nrChannels; channel++ ) {
+    if ( isZapped(configuration.zappedChannels.at(channel)) ) {
+      writeValue(output, channel);
+    }
+  }
+  for ( auto step = configuration.integrationSteps.begin(); step != configuration.integrationSteps.end(); ++step ) {
+    writeValue(output, *step);
+  }
+  if ( !output ) {
+    throw FileError("ERROR: impossible to write configuration blob \"" + filename + "\"");
+  }
+}
+
+void readConfigurationBlob(Observation & observation, const std::string & filename, Configuration & configuration) {
+  MappedFile input(filename, "configuration blob");
+  BlobReader blob(input.getData(), input.getSize(), filename);
+  char magic[sizeof(blobMagic)];
+  uint32_t nrPadding = 0;
+  uint32_t nrVectorWidth = 0;
+  uint32_t nrZappedChannels = 0;
+  uint32_t nrIntegrationSteps = 0;
+  uint32_t nrChannels = 0;
+  uint32_t nrSamplesPerBatch = 0;
+
+  blob.read(magic, sizeof(magic));
+  if ( std::memcmp(magic, blobMagic, sizeof(blobMagic)) != 0 ) {
+    throw FileError("ERROR: \"" + filename + "\" is not a configuration blob");
+  }
+  nrChannels = blob.readValue();
+  nrSamplesPerBatch = blob.readValue();
+  if ( nrChannels != observation.getNrChannels() || nrSamplesPerBatch != observation.getNrSamplesPerBatch() ) {
+    throw FileError("ERROR: configuration blob \"" + filename + "\" was written for a different observation");
+  }
+  nrPadding = blob.readValue();
+  nrVectorWidth = blob.readValue();
+  nrZappedChannels = blob.readValue();
+  nrIntegrationSteps = blob.readValue();
+  blob.readDeviceConf(nrPadding, configuration.padding);
+  blob.readDeviceConf(nrVectorWidth, configuration.vectorWidth);
+  configuration.zappedChannels.assign(observation.getNrChannels(), 0);
+  for ( uint32_t item = 0; item < nrZappedChannels; item++ ) {
+    const uint32_t channel = blob.readValue();
+
+    if ( channel >= observation.getNrChannels() ) {
+      throw FileError("ERROR: configuration blob \"" + filename + "\" is corrupted");
+    }
+    configuration.zappedChannels.at(channel) = 1;
+  }
+  for ( uint32_t item = 0; item < nrIntegrationSteps; item++ ) {
+    const uint32_t step = blob.readValue();
+
+    // The same check as parseIntegrationSteps
+    if ( step >= nrSamplesPerBatch ) {
+      throw FileError("ERROR: integration step " + std::to_string(step) + " in configuration blob \"" + filename + "\" is not smaller than the batch");
+    }
+    configuration.integrationSteps.insert(step);
+  }
+  observation.setNrZappedChannels(nrZappedChannels);
+}
+
+} // AstroData
+
@@ -0,0 +1,340 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <new>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif // HAVE_LIBURING
+
+#include <IOBackend.hpp>
+
+namespace AstroData {
+
+ByteSource::~ByteSource() {}
+
+void ByteSource::prefetch(const uint64_t, const uint64_t) {}
+
+void ByteSource::read(const uint64_t offset, const uint64_t bytes, uint8_t * buffer) {
+  ReadRequest request = {offset, bytes, buffer};
+
+  submit(request);
+  wait();
+}
+
+PreadSource::PreadSource(const std::string & filename) : filename(filename), file(-1), size(0) {
+  struct stat fileStatus;
+
+  file = open(filename.c_str(), O_RDONLY);
+  if ( file < 0 ) {
+    throw FileError("ERROR: impossible to open \"" + filename + "\"");
+  }
+  if ( fstat(file, &fileStatus) < 0 ) {
+    close(file);
+    throw FileError("ERROR: impossible to stat \"" + filename + "\"");
+  }
+  size = fileStatus.st_size;
+}
+
+PreadSource::~PreadSource() {
+  close(file);
+}
+
+uint64_t PreadSource::getSize() const {
+  return size;
+}
+
+void PreadSource::submit(const ReadRequest & request) {
+  uint64_t done = 0;
+
+  while ( done < request.bytes ) {
+    ssize_t result = pread(file, reinterpret_cast<void *>(request.buffer + done), request.bytes - done, request.offset + done);
+
+    if ( result < 0 && errno == EINTR ) {
+      continue;
+    } else if ( result <= 0 ) {
+      throw FileError("ERROR: impossible to read " + std::to_string(request.bytes) + " bytes at offset " + std::to_string(request.offset) + " from \"" + filename + "\"");
+    }
+    done += result;
+  }
+}
+
+void PreadSource::wait() {}
+
+void PreadSource::prefetch(const uint64_t offset, const uint64_t bytes) {
+  posix_fadvise(file, offset, bytes, POSIX_FADV_WILLNEED);
+}
+
+MemorySource::MemorySource(std::vector<uint8_t> data) : data(std::move(data)) {}
+
+MemorySource::~MemorySource() {}
+
+uint64_t MemorySource::getSize() const {
+  return data.size();
+}
+
+void MemorySource::submit(const ReadRequest & request) {
+  if ( request.offset + request.bytes > data.size() ) {
+    throw FileError("ERROR: impossible to read " + std::to_string(request.bytes) + " bytes at offset " + std::to_string(request.offset) + " from memory");
+  }
+  std::memcpy(reinterpret_cast<void *>(request.buffer), reinterpret_cast<const void *>(data.data() + request.offset), request.bytes);
+}
+
+void MemorySource::wait() {}
+
+ConcatenatedSource::ConcatenatedSource() : size(0) {}
+
+ConcatenatedSource::~ConcatenatedSource() {}
+
+void ConcatenatedSource::append(std::unique_ptr<ByteSource> source, const uint64_t offset) {
+  Region region;
+
+  if ( offset > source->getSize() ) {
+    throw FileError("ERROR: impossible to skip " + std::to_string(offset) + " bytes of a " + std::to_string(source->getSize()) + " bytes source");
+  }
+  region.offset = offset;
+  region.start = size;
+  region.bytes = source->getSize() - offset;
+  region.source = std::move(source);
+  size += region.bytes;
+  regions.push_back(std::move(region));
+}
+
+unsigned int ConcatenatedSource::getNrSources() const {
+  return regions.size();
+}
+
+uint64_t ConcatenatedSource::getSize() const {
+  return size;
+}
+
+unsigned int ConcatenatedSource::findRegion(const uint64_t position) const {
+  unsigned int first = 0;
+  unsigned int last = regions.size();
+
+  // Last region starting at or before position
+  while ( last - first > 1 ) {
+    unsigned int middle = first + ((last - first) / 2);
+
+    if ( regions.at(middle).start <= position ) {
+      first = middle;
+    } else {
+      last = middle;
+    }
+  }
+  return first;
+}
+
+void ConcatenatedSource::submit(const ReadRequest & request) {
+  uint64_t done = 0;
+
+  if ( request.offset + request.bytes > size ) {
+    throw FileError("ERROR: impossible to read " + std::to_string(request.bytes) + " bytes at offset " + std::to_string(request.offset) + " from " + std::to_string(regions.size()) + " sources");
+  }
+  for ( unsigned int region = findRegion(request.offset); done < request.bytes; region++ ) {
+    Region & current = regions.at(region);
+    uint64_t position = (request.offset + done) - current.start;
+    uint64_t bytes = std::min(request.bytes - done, current.bytes - position);
+
+    if ( bytes == 0 ) {
+      continue;
+    }
+    current.source->submit(ReadRequest{current.offset + position, bytes, request.buffer + done});
+    if ( std::find(active.begin(), active.end(), region) == active.end() ) {
+      active.push_back(region);
+    }
+    done += bytes;
+  }
+  // The next read of the same size will cross into the next source: let it start loading now
+  if ( request.offset + request.bytes < size && findRegion(request.offset) != findRegion(std::min(size, request.offset + (2 * request.bytes)) - 1) ) {
+    prefetch(request.offset + request.bytes, std::min(request.bytes, size - (request.offset + request.bytes)));
+  }
+}
+
+void ConcatenatedSource::wait() {
+  for ( unsigned int region = 0; region < active.size(); region++ ) {
+    regions.at(active.at(region)).source->wait();
+  }
+  active.clear();
+}
+
+void ConcatenatedSource::prefetch(const uint64_t offset, const uint64_t bytes) {
+  uint64_t done = 0;
+
+  for ( unsigned int region = findRegion(offset); done < bytes && region < regions.size(); region++ ) {
+    Region & current = regions.at(region);
+    uint64_t position = (offset + done) - current.start;
+    uint64_t regionBytes = std::min(bytes - done, current.bytes - position);
+
+    current.source->prefetch(current.offset + position, regionBytes);
+    done += regionBytes;
+  }
+}
+
+#ifdef HAVE_LIBURING
+IOUringSource::IOUringSource(const std::string & filename, const unsigned int queueDepth, const unsigned int bufferSize) : filename(filename), file(-1), size(0), queueDepth(queueDepth), bufferSize(bufferSize), alignment(4096), ring(new io_uring()) {
+  struct stat fileStatus;
+  std::vector<struct iovec> vectors(queueDepth);
+
+  if ( bufferSize <= alignment || bufferSize % alignment != 0 ) {
+    throw FileError("ERROR: io_uring buffer size must be a multiple of " + std::to_string(alignment) + " bytes");
+  }
+  // Not every file system supports O_DIRECT, fall back to buffered reads
+  file = open(filename.c_str(), O_RDONLY | O_DIRECT);
+  if ( file < 0 ) {
+    file = open(filename.c_str(), O_RDONLY);
+  }
+  if ( file < 0 ) {
+    throw FileError("ERROR: impossible to open \"" + filename + "\"");
+  }
+  if ( fstat(file, &fileStatus) < 0 ) {
+    close(file);
+    throw FileError("ERROR: impossible to stat \"" + filename + "\"");
+  }
+  size = fileStatus.st_size;
+  if ( io_uring_queue_init(queueDepth, ring.get(), 0) < 0 ) {
+    close(file);
+    throw FileError("ERROR: impossible to initialize io_uring for \"" + filename + "\"");
+  }
+  buffers.resize(queueDepth, 0);
+  inFlight.resize(queueDepth);
+  for ( unsigned int buffer = 0; buffer < queueDepth; buffer++ ) {
+    void * memory = 0;
+
+    if ( posix_memalign(&memory, alignment, bufferSize) != 0 ) {
+      release();
+      throw std::bad_alloc();
+    }
+    buffers.at(buffer) = reinterpret_cast<uint8_t *>(memory);
+    vectors.at(buffer).iov_base = memory;
+    vectors.at(buffer).iov_len = bufferSize;
+    freeBuffers.push_back(buffer);
+  }
+  if ( io_uring_register_buffers(ring.get(), vectors.data(), queueDepth) < 0 ) {
+    release();
+    throw FileError("ERROR: impossible to register io_uring buffers for \"" + filename + "\"");
+  }
+}
+
+IOUringSource::~IOUringSource() {
+  release();
+}
+
+void IOUringSource::release() {
+  io_uring_queue_exit(ring.get());
+  for ( unsigned int buffer = 0; buffer < buffers.size(); buffer++ ) {
+    std::free(buffers.at(buffer));
+  }
+  close(file);
+}
+
+uint64_t IOUringSource::getSize() const {
+  return size;
+}
+
+void IOUringSource::submit(const ReadRequest & request) {
+  // Leave room in each buffer to align the start of the read
+  const uint64_t chunkBytes = bufferSize - alignment;
+
+  for ( uint64_t done = 0; done < request.bytes; done += chunkBytes ) {
+    Chunk chunk;
+
+    chunk.bytes = std::min(chunkBytes, request.bytes - done);
+    chunk.alignedOffset = (request.offset + done) - ((request.offset + done) % alignment);
+    chunk.skip = (request.offset + done) - chunk.alignedOffset;
+    chunk.alignedBytes = (((chunk.skip + chunk.bytes) + alignment - 1) / alignment) * alignment;
+    chunk.destination = request.buffer + done;
+    pending.push_back(chunk);
+  }
+  submitPending();
+}
+
+void IOUringSource::wait() {
+  std::string error;
+
+  // After a failure the chunks still in flight are drained, so that none is copied after the caller released its buffer
+  while ( freeBuffers.size() < queueDepth || !pending.empty() ) {
+    io_uring_cqe * completion = 0;
+
+    if ( io_uring_wait_cqe(ring.get(), &completion) < 0 ) {
+      throw FileError("ERROR: io_uring wait failed for \"" + filename + "\"");
+    }
+    unsigned int buffer = static_cast<unsigned int>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(completion)));
+    int result = completion->res;
+
+    io_uring_cqe_seen(ring.get(), completion);
+    if ( !error.empty() ) {
+      freeBuffers.push_back(buffer);
+      continue;
+    }
+    if ( !complete(buffer, result) ) {
+      const Chunk & chunk = inFlight.at(buffer);
+
+      error = "ERROR: impossible to read " + std::to_string(chunk.bytes) + " bytes at offset " + std::to_string(chunk.alignedOffset + chunk.skip) + " from \"" + filename + "\"";
+      pending.clear();
+      continue;
+    }
+    submitPending();
+  }
+  if ( !error.empty() ) {
+    throw FileError(error);
+  }
+}
+
+void IOUringSource::submitPending() {
+  unsigned int submitted = 0;
+
+  while ( !freeBuffers.empty() && !pending.empty() ) {
+    io_uring_sqe * submission = io_uring_get_sqe(ring.get());
+
+    if ( submission == 0 ) {
+      break;
+    }
+    unsigned int buffer = freeBuffers.back();
+
+    freeBuffers.pop_back();
+    inFlight.at(buffer) = pending.front();
+    pending.pop_front();
+    io_uring_prep_read_fixed(submission, file, reinterpret_cast<void *>(buffers.at(buffer)), inFlight.at(buffer).alignedBytes, inFlight.at(buffer).alignedOffset, buffer);
+    io_uring_sqe_set_data(submission, reinterpret_cast<void *>(static_cast<uintptr_t>(buffer)));
+    submitted++;
+  }
+  if ( submitted > 0 && io_uring_submit(ring.get()) < 0 ) {
+    throw FileError("ERROR: io_uring submission failed for \"" + filename + "\"");
+  }
+}
+
+bool IOUringSource::complete(const unsigned int buffer, const int result) {
+  const Chunk & chunk = inFlight.at(buffer);
+
+  freeBuffers.push_back(buffer);
+  // The aligned read may stop at the end of the file, but must cover the requested bytes
+  if ( result < 0 || static_cast<uint64_t>(result) < chunk.skip + chunk.bytes ) {
+    return false;
+  }
+  std::memcpy(reinterpret_cast<void *>(chunk.destination), reinterpret_cast<const void *>(buffers.at(buffer) + chunk.skip), chunk.bytes);
+  return true;
+}
+#endif // HAVE_LIBURING
+
+} // AstroData
+
@@ -0,0 +1,194 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <mutex>
+#include <algorithm>
+#include <thread>
+#include <memory>
+#include <condition_variable>
+
+#include <Instrumentation.hpp>
+
+namespace {
+
+// Counters of all threads that ever recorded something; never released, so totals survive thread exit
+std::mutex registryMutex;
+std::vector<std::unique_ptr<AstroData::ThreadCounters>> registry;
+
+// Periodic dump
+std::mutex dumpMutex;
+std::condition_variable dumpCondition;
+bool dumpRunning = false;
+
+// A thread still running at exit would terminate the program, so it is stopped with the static objects
+struct DumpThread {
+  ~DumpThread();
+
+  std::thread thread;
+};
+
+DumpThread dumpThread;
+
+double calibrateTickPeriod() {
+#if defined(INSTRUMENTATION_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  uint64_t startTicks = AstroData::getInstrumentationTicks();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  uint64_t ticks = AstroData::getInstrumentationTicks() - startTicks;
+  double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  return nanoseconds / ticks;
+#else
+  return 1.0;
+#endif
+}
+
+DumpThread::~DumpThread() {
+  AstroData::stopInstrumentationDump();
+}
+
+} // namespace
+
+namespace AstroData {
+
+ThreadCounters::ThreadCounters() {
+  reset();
+}
+
+ThreadCounters::~ThreadCounters() {}
+
+PhaseCounters ThreadCounters::get(const InstrumentationPhase phase) const {
+  const unsigned int index = static_cast<unsigned int>(phase);
+  PhaseCounters counters;
+
+  counters.calls = calls[index].load(std::memory_order_relaxed);
+  counters.nanoseconds = ticks[index].load(std::memory_order_relaxed);
+  counters.bytes = bytes[index].load(std::memory_order_relaxed);
+  return counters;
+}
+
+void ThreadCounters::reset() {
+  for ( unsigned int phase = 0; phase < nrInstrumentationPhases; phase++ ) {
+    calls[phase].store(0, std::memory_order_relaxed);
+    ticks[phase].store(0, std::memory_order_relaxed);
+    bytes[phase].store(0, std::memory_order_relaxed);
+  }
+}
+
+ThreadCounters & getThreadCounters() {
+  thread_local ThreadCounters * counters = 0;
+
+  if ( counters == 0 ) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    registry.push_back(std::unique_ptr<ThreadCounters>(new ThreadCounters()));
+    counters = registry.back().get();
+  }
+  return *counters;
+}
+
+std::vector<PhaseCounters> getInstrumentationCounters() {
+  std::vector<PhaseCounters> counters(nrInstrumentationPhases, PhaseCounters{0, 0, 0});
+  std::lock_guard<std::mutex> lock(registryMutex);
+
+  for ( unsigned int thread = 0; thread < registry.size(); thread++ ) {
+    for ( unsigned int phase = 0; phase < nrInstrumentationPhases; phase++ ) {
+      PhaseCounters threadCounters = registry.at(thread)->get(static_cast<InstrumentationPhase>(phase));
+
+      counters.at(phase).calls += threadCounters.calls;
+      counters.at(phase).nanoseconds += threadCounters.nanoseconds;
+      counters.at(phase).bytes += threadCounters.bytes;
+    }
+  }
+  for ( unsigned int phase = 0; phase < nrInstrumentationPhases; phase++ ) {
+    counters.at(phase).nanoseconds = static_cast<uint64_t>(counters.at(phase).nanoseconds * getInstrumentationTickPeriod());
+  }
+  return counters;
+}
+
+void resetInstrumentationCounters() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+
+  for ( unsigned int thread = 0; thread < registry.size(); thread++ ) {
+    registry.at(thread)->reset();
+  }
+}
+
+std::string getPhaseName(const InstrumentationPhase phase) {
+  switch ( phase ) {
+    case InstrumentationPhase::Read:
+      return "read";
+    case InstrumentationPhase::Decode:
+      return "decode";
+    case InstrumentationPhase::Transpose:
+      return "transpose";
+    case InstrumentationPhase::Allocate:
+      return "allocate";
+  }
+  return "unknown";
+}
+
+void dumpInstrumentationCounters(std::ostream & output) {
+  std::vector<PhaseCounters> counters = getInstrumentationCounters();
+
+  for ( unsigned int phase = 0; phase < nrInstrumentationPhases; phase++ ) {
+    output << getPhaseName(static_cast<InstrumentationPhase>(phase)) << " calls " << counters.at(phase).calls << " ns " << counters.at(phase).nanoseconds << " bytes " << counters.at(phase).bytes;
+    if ( phase + 1 < nrInstrumentationPhases ) {
+      output << " ";
+    }
+  }
+  output << std::endl;
+}
+
+void startInstrumentationDump(std::ostream & output, const unsigned int period) {
+  // A period of zero would make the thread spin
+  const unsigned int seconds = std::max(period, 1u);
+
+  stopInstrumentationDump();
+  {
+    std::lock_guard<std::mutex> lock(dumpMutex);
+
+    dumpRunning = true;
+  }
+  dumpThread.thread = std::thread([&output, seconds]() {
+    std::unique_lock<std::mutex> lock(dumpMutex);
+
+    while ( !dumpCondition.wait_for(lock, std::chrono::seconds(seconds), []() { return !dumpRunning; }) ) {
+      dumpInstrumentationCounters(output);
+    }
+  });
+}
+
+void stopInstrumentationDump() {
+  {
+    std::lock_guard<std::mutex> lock(dumpMutex);
+
+    dumpRunning = false;
+  }
+  dumpCondition.notify_all();
+  if ( dumpThread.thread.joinable() ) {
+    dumpThread.thread.join();
+  }
+}
+
+double getInstrumentationTickPeriod() {
+  static const double period = calibrateTickPeriod();
+
+  return period;
+}
+
+} // AstroData
+
@@ -0,0 +1,187 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <new>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include <NUMA.hpp>
+
+namespace {
+
+const std::string nodePath = "/sys/devices/system/node/";
+
+// Parse a kernel CPU list, e.g. "0-7,16-23"
+std::vector<unsigned int> parseCPUList(const std::string & list) {
+  std::vector<unsigned int> cpus;
+  std::stringstream listStream(list);
+  std::string range;
+
+  while ( std::getline(listStream, range, ',') ) {
+    std::string::size_type separator = range.find('-');
+
+    if ( range.empty() ) {
+      continue;
+    }
+    if ( separator == std::string::npos ) {
+      cpus.push_back(std::stoul(range));
+    } else {
+      for ( unsigned int cpu = std::stoul(range.substr(0, separator)); cpu <= std::stoul(range.substr(separator + 1)); cpu++ ) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+std::vector<unsigned int> readNUMANodes() {
+  std::ifstream online(nodePath + "online");
+  std::string list;
+  std::vector<unsigned int> nodes;
+
+  if ( online && std::getline(online, list) ) {
+    nodes = parseCPUList(list);
+  }
+  if ( nodes.empty() ) {
+    nodes.push_back(0);
+  }
+  return nodes;
+}
+
+uint64_t getPageSize() {
+  return sysconf(_SC_PAGESIZE);
+}
+
+} // namespace
+
+namespace AstroData {
+
+const std::vector<unsigned int> & getNUMANodes() {
+  static const std::vector<unsigned int> nodes = readNUMANodes();
+
+  return nodes;
+}
+
+unsigned int getNrNUMANodes() {
+  return getNUMANodes().size();
+}
+
+unsigned int getCurrentNUMANode() {
+  unsigned int cpu = 0;
+  unsigned int node = 0;
+
+  if ( syscall(SYS_getcpu, &cpu, &node, 0) < 0 ) {
+    return 0;
+  }
+  return node;
+}
+
+std::vector<unsigned int> getNUMANodeCPUs(const unsigned int node) {
+  std::ifstream cpuList(nodePath + "node" + std::to_string(node) + "/cpulist");
+  std::string list;
+  std::vector<unsigned int> cpus;
+
+  if ( cpuList && std::getline(cpuList, list) ) {
+    cpus = parseCPUList(list);
+  }
+  if ( cpus.empty() ) {
+    // No NUMA information, every CPU belongs to the only node
+    for ( unsigned int cpu = 0; cpu < static_cast<unsigned int>(sysconf(_SC_NPROCESSORS_ONLN)); cpu++ ) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+unsigned int getPolicyNode(const NUMAPolicy & policy, const unsigned int batch) {
+  if ( policy.mode == NUMAMode::Interleave ) {
+    return getNUMANodes().at(batch % getNrNUMANodes());
+  }
+  return policy.node;
+}
+
+void pinThreadToNode(const unsigned int node) {
+  std::vector<unsigned int> cpus = getNUMANodeCPUs(node);
+  cpu_set_t affinity;
+
+  CPU_ZERO(&affinity);
+  for ( unsigned int cpu = 0; cpu < cpus.size(); cpu++ ) {
+    CPU_SET(cpus.at(cpu), &affinity);
+  }
+  // Affinity is a hint for placement, failing to set it is not an error
+  sched_setaffinity(0, sizeof(cpu_set_t), &affinity);
+}
+
+bool placeMemory(void * pointer, const uint64_t bytes, const NUMAPolicy & policy) {
+  const uint64_t pageSize = getPageSize();
+  const std::vector<unsigned int> & nodes = getNUMANodes();
+  const unsigned int bitsPerLong = sizeof(unsigned long) * 8;
+  const unsigned int maxNode = std::max(*std::max_element(nodes.begin(), nodes.end()), policy.node);
+  std::vector<unsigned long> nodeMask((maxNode / bitsPerLong) + 1, 0);
+  int mode = MPOL_DEFAULT;
+
+  if ( reinterpret_cast<uint64_t>(pointer) % pageSize != 0 ) {
+    return false;
+  }
+  if ( policy.mode == NUMAMode::Default || nodes.size() < 2 || bytes == 0 ) {
+    return true;
+  } else if ( policy.mode == NUMAMode::Interleave ) {
+    mode = MPOL_INTERLEAVE;
+    for ( unsigned int node = 0; node < nodes.size(); node++ ) {
+      nodeMask.at(nodes.at(node) / bitsPerLong) |= 1UL << (nodes.at(node) % bitsPerLong);
+    }
+  } else {
+    mode = MPOL_BIND;
+    nodeMask.at(policy.node / bitsPerLong) |= 1UL << (policy.node % bitsPerLong);
+  }
+  // The kernel reads maxnode - 1 bits
+  return syscall(SYS_mbind, pointer, ((bytes + pageSize - 1) / pageSize) * pageSize, mode, nodeMask.data(), (nodeMask.size() * bitsPerLong) + 1, MPOL_MF_MOVE) == 0;
+}
+
+void * allocateNUMAMemory(const uint64_t bytes, const NUMAPolicy & policy) {
+  void * pointer = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if ( pointer == MAP_FAILED ) {
+    throw std::bad_alloc();
+  }
+  // Placement is best effort, the memory is usable anyway
+  placeMemory(pointer, bytes, policy);
+  return pointer;
+}
+
+void releaseNUMAMemory(void * pointer, const uint64_t bytes) {
+  if ( pointer != 0 ) {
+    munmap(pointer, bytes);
+  }
+}
+
+ScopedAffinity::ScopedAffinity() {
+  saved = sched_getaffinity(0, sizeof(cpu_set_t), &affinity) == 0;
+}
+
+ScopedAffinity::~ScopedAffinity() {
+  if ( saved ) {
+    sched_setaffinity(0, sizeof(cpu_set_t), &affinity);
+  }
+}
+
+} // AstroData
+
@@ -13,10 +13,126 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <map>
+#include <sstream>
+#include <cstring>
+
 #include <Observation.hpp>
+#include <Platform.hpp>
+
+namespace {
+
+// Magic number at the beginning of a binary snapshot ("ADOB")
+const uint32_t observationMagic = 0x424F4441;
+// Number of parameters stored in a binary snapshot
+const uint32_t observationNrFields = 34;
+// FNV-1a parameters
+const uint64_t hashOffset = 14695981039346656037ULL;
+const uint64_t hashPrime = 1099511628211ULL;
+
+void writeUInt32(std::vector<uint8_t> & buffer, const uint32_t value) {
+  for ( unsigned int byte = 0; byte < 4; byte++ ) {
+    buffer.push_back(static_cast<uint8_t>(value >> (byte * 8)));
+  }
+}
+
+void writeUInt64(std::vector<uint8_t> & buffer, const uint64_t value) {
+  writeUInt32(buffer, static_cast<uint32_t>(value));
+  writeUInt32(buffer, static_cast<uint32_t>(value >> 32));
+}
+
+void writeFloat(std::vector<uint8_t> & buffer, const float value) {
+  uint32_t bits = 0;
+
+  std::memcpy(reinterpret_cast<void *>(&bits), reinterpret_cast<const void *>(&value), sizeof(float));
+  writeUInt32(buffer, bits);
+}
+
+uint32_t readUInt32(const std::vector<uint8_t> & buffer, std::size_t & position) {
+  uint32_t value = 0;
+
+  if ( position + 4 > buffer.size() ) {
+    throw AstroData::ObservationError("ERROR: truncated observation snapshot");
+  }
+  for ( unsigned int byte = 0; byte < 4; byte++ ) {
+    value |= static_cast<uint32_t>(buffer[position + byte]) << (byte * 8);
+  }
+  position += 4;
+  return value;
+}
+
+uint64_t readUInt64(const std::vector<uint8_t> & buffer, std::size_t & position) {
+  uint64_t low = readUInt32(buffer, position);
+  uint64_t high = readUInt32(buffer, position);
+
+  return (high << 32) | low;
+}
+
+float readFloat(const std::vector<uint8_t> & buffer, std::size_t & position) {
+  uint32_t bits = readUInt32(buffer, position);
+  float value = 0.0f;
+
+  std::memcpy(reinterpret_cast<void *>(&value), reinterpret_cast<const void *>(&bits), sizeof(float));
+  return value;
+}
+
+void hashUInt32(uint64_t & hash, const uint32_t value) {
+  for ( unsigned int byte = 0; byte < 4; byte++ ) {
+    hash ^= static_cast<uint8_t>(value >> (byte * 8));
+    hash *= hashPrime;
+  }
+}
+
+const std::string & getTextValue(const std::map<std::string, std::string> & values, const std::string & key) {
+  std::map<std::string, std::string>::const_iterator item = values.find(key);
+
+  if ( item == values.end() ) {
+    throw AstroData::ObservationError("ERROR: missing \"" + key + "\" in observation description");
+  }
+  return item->second;
+}
+
+unsigned int textToUInt(const std::map<std::string, std::string> & values, const std::string & key) {
+  const std::string & value = getTextValue(values, key);
+  const char * position = value.data();
+  unsigned int result = 0;
+
+  // Only digits, no sign, trailing characters or values that do not fit
+  if ( !AstroData::parseUnsigned(position, value.data() + value.size(), result) || position != value.data() + value.size() ) {
+    throw AstroData::ObservationError("ERROR: invalid value \"" + value + "\" for \"" + key + "\"");
+  }
+  return result;
+}
+
+float textToFloat(const std::map<std::string, std::string> & values, const std::string & key) {
+  const std::string & value = getTextValue(values, key);
+  std::size_t position = 0;
+  float result = 0.0f;
+
+  try {
+    result = std::stof(value, &position);
+  } catch ( std::exception & err ) {
+    throw AstroData::ObservationError("ERROR: invalid value \"" + value + "\" for \"" + key + "\"");
+  }
+  // No trailing characters
+  if ( position != value.size() ) {
+    throw AstroData::ObservationError("ERROR: invalid value \"" + value + "\" for \"" + key + "\"");
+  }
+  return result;
+}
+
+} // namespace
 
 namespace AstroData {
 
+ObservationError::ObservationError(const std::string & message) : message(message) {}
+
+ObservationError::~ObservationError() noexcept {}
+
+const char * ObservationError::what() const noexcept {
+  return message.c_str();
+}
+
 Observation::Observation() : nrBatches(0), nrStations(0), nrBeams(0), nrSynthesizedBeams(0), samplingTime(0.0f), nrSamplesPerBatch(0), nrSamplesPerBatch_subbanding(0), nrSamplesPerDispersedBatch(0), nrSamplesPerDispersedBatch_subbanding(0), nrSubbands(0), nrChannels(0), nrChannelsPerSubband(0), nrZappedChannels(0), minSubbandFreq(0.0), maxSubbandFreq(0.0), subbandBandwidth(0.0), minChannelFreq(0.0f), maxChannelFreq(0.0f), channelBandwidth(0.0f), nrDelayBatches(0), nrDelayBatches_subbanding(0), nrDMs(0), nrDMs_subbanding(0), firstDM(0.0f), firstDM_subbanding(0.0f), lastDM(0.0f), lastDM_subbanding(0.0f), DMStep(0.0f), DMStep_subbanding(0.0f), nrPeriods(0), firstPeriod(0), lastPeriod(0), periodStep(0), nrBins(0) {}
 
 Observation::~Observation() {}
@@ -214,5 +330,249 @@ void Observation::setNrSamplesPerDispersedBatch(const unsigned int samples, cons
   }
 }
 
-} // AstroData
+uint64_t Observation::getLayoutHash() const {
+  uint64_t hash = hashOffset;
+
+  hashUInt32(hash, nrStations);
+  hashUInt32(hash, nrBeams);
+  hashUInt32(hash, nrSynthesizedBeams);
+  hashUInt32(hash, nrSamplesPerBatch);
+  hashUInt32(hash, nrSamplesPerBatch_subbanding);
+  hashUInt32(hash, nrSamplesPerDispersedBatch);
+  hashUInt32(hash, nrSamplesPerDispersedBatch_subbanding);
+  hashUInt32(hash, nrSubbands);
+  hashUInt32(hash, nrChannels);
+  hashUInt32(hash, nrChannelsPerSubband);
+  hashUInt32(hash, nrDelayBatches);
+  hashUInt32(hash, nrDelayBatches_subbanding);
+  hashUInt32(hash, nrDMs);
+  hashUInt32(hash, nrDMs_subbanding);
+  hashUInt32(hash, nrPeriods);
+  hashUInt32(hash, nrBins);
+  return hash;
+}
+
+void Observation::serialize(std::vector<uint8_t> & buffer) const {
+  buffer.clear();
+  writeUInt32(buffer, observationMagic);
+  writeUInt32(buffer, observationSerializationVersion);
+  writeUInt64(buffer, getLayoutHash());
+  writeUInt32(buffer, observationNrFields);
+  // General observation parameters
+  writeUInt32(buffer, nrBatches);
+  writeUInt32(buffer, nrStations);
+  writeUInt32(buffer, nrBeams);
+  writeUInt32(buffer, nrSynthesizedBeams);
+  writeFloat(buffer, samplingTime);
+  writeUInt32(buffer, nrSamplesPerBatch);
+  writeUInt32(buffer, nrSamplesPerBatch_subbanding);
+  writeUInt32(buffer, nrSamplesPerDispersedBatch);
+  writeUInt32(buffer, nrSamplesPerDispersedBatch_subbanding);
+  // Frequency parameters
+  writeUInt32(buffer, nrSubbands);
+  writeUInt32(buffer, nrChannels);
+  writeUInt32(buffer, nrChannelsPerSubband);
+  writeUInt32(buffer, nrZappedChannels);
+  writeFloat(buffer, minSubbandFreq);
+  writeFloat(buffer, maxSubbandFreq);
+  writeFloat(buffer, subbandBandwidth);
+  writeFloat(buffer, minChannelFreq);
+  writeFloat(buffer, maxChannelFreq);
+  writeFloat(buffer, channelBandwidth);
+  // Dispersion measures
+  writeUInt32(buffer, nrDelayBatches);
+  writeUInt32(buffer, nrDelayBatches_subbanding);
+  writeUInt32(buffer, nrDMs);
+  writeUInt32(buffer, nrDMs_subbanding);
+  writeFloat(buffer, firstDM);
+  writeFloat(buffer, firstDM_subbanding);
+  writeFloat(buffer, lastDM);
+  writeFloat(buffer, lastDM_subbanding);
+  writeFloat(buffer, DMStep);
+  writeFloat(buffer, DMStep_subbanding);
+  // Periods
+  writeUInt32(buffer, nrPeriods);
+  writeUInt32(buffer, firstPeriod);
+  writeUInt32(buffer, lastPeriod);
+  writeUInt32(buffer, periodStep);
+  writeUInt32(buffer, nrBins);
+}
+
+void Observation::deserialize(const std::vector<uint8_t> & buffer) {
+  std::size_t position = 0;
+  Observation temp;
+
+  if ( readUInt32(buffer, position) != observationMagic ) {
+    throw ObservationError("ERROR: not an observation snapshot");
+  }
+  uint32_t version = readUInt32(buffer, position);
+  if ( version != observationSerializationVersion ) {
+    throw ObservationError("ERROR: unsupported observation snapshot version " + std::to_string(version));
+  }
+  uint64_t layoutHash = readUInt64(buffer, position);
+  if ( readUInt32(buffer, position) != observationNrFields ) {
+    throw ObservationError("ERROR: wrong number of parameters in observation snapshot");
+  }
+  // General observation parameters
+  temp.nrBatches = readUInt32(buffer, position);
+  temp.nrStations = readUInt32(buffer, position);
+  temp.nrBeams = readUInt32(buffer, position);
+  temp.nrSynthesizedBeams = readUInt32(buffer, position);
+  temp.samplingTime = readFloat(buffer, position);
+  temp.nrSamplesPerBatch = readUInt32(buffer, position);
+  temp.nrSamplesPerBatch_subbanding = readUInt32(buffer, position);
+  temp.nrSamplesPerDispersedBatch = readUInt32(buffer, position);
+  temp.nrSamplesPerDispersedBatch_subbanding = readUInt32(buffer, position);
+  // Frequency parameters
+  temp.nrSubbands = readUInt32(buffer, position);
+  temp.nrChannels = readUInt32(buffer, position);
+  temp.nrChannelsPerSubband = readUInt32(buffer, position);
+  temp.nrZappedChannels = readUInt32(buffer, position);
+  temp.minSubbandFreq = readFloat(buffer, position);
+  temp.maxSubbandFreq = readFloat(buffer, position);
+  temp.subbandBandwidth = readFloat(buffer, position);
+  temp.minChannelFreq = readFloat(buffer, position);
+  temp.maxChannelFreq = readFloat(buffer, position);
+  temp.channelBandwidth = readFloat(buffer, position);
+  // Dispersion measures
+  temp.nrDelayBatches = readUInt32(buffer, position);
+  temp.nrDelayBatches_subbanding = readUInt32(buffer, position);
+  temp.nrDMs = readUInt32(buffer, position);
+  temp.nrDMs_subbanding = readUInt32(buffer, position);
+  temp.firstDM = readFloat(buffer, position);
+  temp.firstDM_subbanding = readFloat(buffer, position);
+  temp.lastDM = readFloat(buffer, position);
+  temp.lastDM_subbanding = readFloat(buffer, position);
+  temp.DMStep = readFloat(buffer, position);
+  temp.DMStep_subbanding = readFloat(buffer, position);
+  // Periods
+  temp.nrPeriods = readUInt32(buffer, position);
+  temp.firstPeriod = readUInt32(buffer, position);
+  temp.lastPeriod = readUInt32(buffer, position);
+  temp.periodStep = readUInt32(buffer, position);
+  temp.nrBins = readUInt32(buffer, position);
+
+  if ( temp.getLayoutHash() != layoutHash ) {
+    throw ObservationError("ERROR: layout hash mismatch in observation snapshot");
+  }
+  *this = temp;
+}
+
+void Observation::serializeText(std::ostream & output) const {
+  std::streamsize precision = output.precision(std::numeric_limits<float>::max_digits10);
+
+  output << "version " << observationSerializationVersion << std::endl;
+  output << "layoutHash " << getLayoutHash() << std::endl;
+  // General observation parameters
+  output << "nrBatches " << nrBatches << std::endl;
+  output << "nrStations " << nrStations << std::endl;
+  output << "nrBeams " << nrBeams << std::endl;
+  output << "nrSynthesizedBeams " << nrSynthesizedBeams << std::endl;
+  output << "samplingTime " << samplingTime << std::endl;
+  output << "nrSamplesPerBatch " << nrSamplesPerBatch << std::endl;
+  output << "nrSamplesPerBatch_subbanding " << nrSamplesPerBatch_subbanding << std::endl;
+  output << "nrSamplesPerDispersedBatch " << nrSamplesPerDispersedBatch << std::endl;
+  output << "nrSamplesPerDispersedBatch_subbanding " << nrSamplesPerDispersedBatch_subbanding << std::endl;
+  // Frequency parameters
+  output << "nrSubbands " << nrSubbands << std::endl;
+  output << "nrChannels " << nrChannels << std::endl;
+  output << "nrChannelsPerSubband " << nrChannelsPerSubband << std::endl;
+  output << "nrZappedChannels " << nrZappedChannels << std::endl;
+  output << "minSubbandFreq " << minSubbandFreq << std::endl;
+  output << "maxSubbandFreq " << maxSubbandFreq << std::endl;
+  output << "subbandBandwidth " << subbandBandwidth << std::endl;
+  output << "minChannelFreq " << minChannelFreq << std::endl;
+  output << "maxChannelFreq " << maxChannelFreq << std::endl;
+  output << "channelBandwidth " << channelBandwidth << std::endl;
+  // Dispersion measures
+  output << "nrDelayBatches " << nrDelayBatches << std::endl;
+  output << "nrDelayBatches_subbanding " << nrDelayBatches_subbanding << std::endl;
+  output << "nrDMs " << nrDMs << std::endl;
+  output << "nrDMs_subbanding " << nrDMs_subbanding << std::endl;
+  output << "firstDM " << firstDM << std::endl;
+  output << "firstDM_subbanding " << firstDM_subbanding << std::endl;
+  output << "lastDM " << lastDM << std::endl;
+  output << "lastDM_subbanding " << lastDM_subbanding << std::endl;
+  output << "DMStep " << DMStep << std::endl;
+  output << "DMStep_subbanding " << DMStep_subbanding << std::endl;
+  // Periods
+  output << "nrPeriods " << nrPeriods << std::endl;
+  output << "firstPeriod " << firstPeriod << std::endl;
+  output << "lastPeriod " << lastPeriod << std::endl;
+  output << "periodStep " << periodStep << std::endl;
+  output << "nrBins " << nrBins << std::endl;
+  output.precision(precision);
+}
+
+void Observation::deserializeText(std::istream & input) {
+  std::string line;
+  std::map<std::string, std::string> values;
+  Observation temp;
+
+  while ( std::getline(input, line) ) {
+    std::string key, value;
+    std::istringstream lineStream(line);
+
+    if ( !(lineStream >> key) || key[0] == '#' ) {
+      continue;
+    }
+    if ( !(lineStream >> value) ) {
+      throw ObservationError("ERROR: missing value for \"" + key + "\" in observation description");
+    }
+    values[key] = value;
+  }
+  if ( textToUInt(values, "version") != observationSerializationVersion ) {
+    throw ObservationError("ERROR: unsupported observation description version " + getTextValue(values, "version"));
+  }
+  // General observation parameters
+  temp.nrBatches = textToUInt(values, "nrBatches");
+  temp.nrStations = textToUInt(values, "nrStations");
+  temp.nrBeams = textToUInt(values, "nrBeams");
+  temp.nrSynthesizedBeams = textToUInt(values, "nrSynthesizedBeams");
+  temp.samplingTime = textToFloat(values, "samplingTime");
+  temp.nrSamplesPerBatch = textToUInt(values, "nrSamplesPerBatch");
+  temp.nrSamplesPerBatch_subbanding = textToUInt(values, "nrSamplesPerBatch_subbanding");
+  temp.nrSamplesPerDispersedBatch = textToUInt(values, "nrSamplesPerDispersedBatch");
+  temp.nrSamplesPerDispersedBatch_subbanding = textToUInt(values, "nrSamplesPerDispersedBatch_subbanding");
+  // Frequency parameters
+  temp.nrSubbands = textToUInt(values, "nrSubbands");
+  temp.nrChannels = textToUInt(values, "nrChannels");
+  temp.nrChannelsPerSubband = textToUInt(values, "nrChannelsPerSubband");
+  temp.nrZappedChannels = textToUInt(values, "nrZappedChannels");
+  temp.minSubbandFreq = textToFloat(values, "minSubbandFreq");
+  temp.maxSubbandFreq = textToFloat(values, "maxSubbandFreq");
+  temp.subbandBandwidth = textToFloat(values, "subbandBandwidth");
+  temp.minChannelFreq = textToFloat(values, "minChannelFreq");
+  temp.maxChannelFreq = textToFloat(values, "maxChannelFreq");
+  temp.channelBandwidth = textToFloat(values, "channelBandwidth");
+  // Dispersion measures
+  temp.nrDelayBatches = textToUInt(values, "nrDelayBatches");
+  temp.nrDelayBatches_subbanding = textToUInt(values, "nrDelayBatches_subbanding");
+  temp.nrDMs = textToUInt(values, "nrDMs");
+  temp.nrDMs_subbanding = textToUInt(values, "nrDMs_subbanding");
+  temp.firstDM = textToFloat(values, "firstDM");
+  temp.firstDM_subbanding = textToFloat(values, "firstDM_subbanding");
+  temp.lastDM = textToFloat(values, "lastDM");
+  temp.lastDM_subbanding = textToFloat(values, "lastDM_subbanding");
+  temp.DMStep = textToFloat(values, "DMStep");
+  temp.DMStep_subbanding = textToFloat(values, "DMStep_subbanding");
+  // Periods
+  temp.nrPeriods = textToUInt(values, "nrPeriods");
+  temp.firstPeriod = textToUInt(values, "firstPeriod");
+  temp.lastPeriod = textToUInt(values, "lastPeriod");
+  temp.periodStep = textToUInt(values, "periodStep");
+  temp.nrBins = textToUInt(values, "nrBins");
 
+  // The hash is optional in hand-written descriptions, but must match when present
+  if ( values.find("layoutHash") != values.end() ) {
+    std::istringstream hashStream(getTextValue(values, "layoutHash"));
+    uint64_t layoutHash = 0;
+
+    if ( !(hashStream >> layoutHash) || layoutHash != temp.getLayoutHash() ) {
+      throw ObservationError("ERROR: layout hash mismatch in observation description");
+    }
+  }
+  *this = temp;
+}
+
+} // AstroData
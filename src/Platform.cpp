@@ -13,6 +13,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <limits>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <Platform.hpp>
 
 namespace AstroData {
@@ -25,42 +34,95 @@ const char * FileError::what() const noexcept {
   return message.c_str();
 }
 
-void readPaddingConf(paddingConf & padding, const std::string & paddingFilename) {
-  std::string temp;
-  std::ifstream paddingFile(paddingFilename);
+MappedFile::MappedFile(const std::string & filename, const std::string & kind) : data(0), size(0) {
+  struct stat status;
+  int file = open(filename.c_str(), O_RDONLY);
 
-  if ( !paddingFile ) {
-    throw FileError("ERROR: impossible to open padding file \"" + paddingFilename + "\"");
+  if ( file < 0 || fstat(file, &status) != 0 ) {
+    if ( file >= 0 ) {
+      close(file);
+    }
+    throw FileError("ERROR: impossible to open " + kind + " file \"" + filename + "\"");
   }
-  while ( ! paddingFile.eof() ) {
-    unsigned int middle = 0;
-
-    std::getline(paddingFile, temp);
-    if ( ! std::isalpha(temp[0]) ) {
-      continue;
+  size = status.st_size;
+  // Empty files cannot be mapped
+  if ( size > 0 ) {
+    data = mmap(0, size, PROT_READ, MAP_PRIVATE, file, 0);
+    if ( data == MAP_FAILED ) {
+      data = 0;
+      close(file);
+      throw FileError("ERROR: impossible to map " + kind + " file \"" + filename + "\"");
     }
-    middle = temp.find(" ");
-    padding.insert(std::make_pair(temp.substr(0, middle), isa::utils::castToType<std::string, unsigned int>(temp.substr(middle + 1))));
   }
+  close(file);
+}
+
+MappedFile::~MappedFile() {
+  if ( data != 0 ) {
+    munmap(data, size);
+  }
+}
+
+void readPaddingConf(paddingConf & padding, const std::string & paddingFilename) {
+  MappedFile paddingFile(paddingFilename, "padding");
+
+  parseDeviceConf(paddingFile.getData(), paddingFile.getSize(), paddingFilename, padding);
 }
 
 void readVectorWidthConf(vectorWidthConf & vectorWidth, const std::string & vectorFilename) {
-  std::string temp;
-  std::ifstream vectorFile(vectorFilename);
+  MappedFile vectorFile(vectorFilename, "vector");
+
+  parseDeviceConf(vectorFile.getData(), vectorFile.getSize(), vectorFilename, vectorWidth);
+}
+
+void parseDeviceConf(const char * text, const uint64_t size, const std::string & filename, std::map<std::string, unsigned int> & values) {
+  const char * end = text + size;
+  unsigned int line = 0;
+
+  while ( text < end ) {
+    const char * lineEnd = static_cast<const char *>(std::memchr(text, '\n', end - text));
+    const char * nameEnd = 0;
+    unsigned int value = 0;
 
-  if ( !vectorFile ) {
-    throw FileError("ERROR: impossible to open vector file \"" + vectorFilename + "\"");
+    if ( lineEnd == 0 ) {
+      lineEnd = end;
+    }
+    line++;
+    if ( std::isalpha(static_cast<unsigned char>(*text)) ) {
+      nameEnd = std::find(text, lineEnd, ' ');
+      const char * position = nameEnd;
+
+      while ( position < lineEnd && *position == ' ' ) {
+        position++;
+      }
+      if ( nameEnd == lineEnd || !parseUnsigned(position, lineEnd, value) ) {
+        throw FileError("ERROR: malformed line " + std::to_string(line) + " of \"" + filename + "\", expected \"device value\"");
+      }
+      while ( position < lineEnd && std::isspace(static_cast<unsigned char>(*position)) ) {
+        position++;
+      }
+      if ( position != lineEnd ) {
+        throw FileError("ERROR: malformed line " + std::to_string(line) + " of \"" + filename + "\", expected \"device value\"");
+      }
+      values.insert(std::make_pair(std::string(text, nameEnd), value));
+    }
+    text = lineEnd + 1;
   }
-  while ( ! vectorFile.eof() ) {
-    unsigned int middle = 0;
+}
+
+bool parseUnsigned(const char * & position, const char * end, unsigned int & value) {
+  const char * first = position;
+  uint64_t result = 0;
 
-    std::getline(vectorFile, temp);
-    if ( ! std::isalpha(temp[0]) ) {
-      continue;
+  while ( position < end && *position >= '0' && *position <= '9' ) {
+    result = (result * 10) + (*position - '0');
+    if ( result > std::numeric_limits<unsigned int>::max() ) {
+      return false;
     }
-    middle = temp.find(" ");
-    vectorWidth.insert(std::make_pair(temp.substr(0, middle), isa::utils::castToType<std::string, unsigned int>(temp.substr(middle + 1))));
+    position++;
   }
+  value = static_cast<unsigned int>(result);
+  return position != first;
 }
 
 } // AstroData
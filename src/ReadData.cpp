@@ -25,43 +25,15 @@ const char * RingBufferError::what() const noexcept {
     return message.c_str();
 }
 
-void readZappedChannels(Observation & observation, const std::string & inputFilename, std::vector<unsigned int> & zappedChannels) {
-  unsigned int nrChannels = 0;
-  std::ifstream input;
-
-  input.open(inputFilename);
-  if ( !input ) {
-    throw FileError("ERROR: impossible to open zapped channels file \"" + inputFilename + "\"");
-  }
-  while ( !input.eof() ) {
-    unsigned int channel = observation.getNrChannels();
-
-    input >> channel;
-    if ( channel < observation.getNrChannels() ) {
-      zappedChannels[channel] = 1;
-      nrChannels++;
-    }
-  }
-  input.close();
-  observation.setNrZappedChannels(nrChannels);
-}
-
-void readIntegrationSteps(const Observation & observation, const std::string  & inputFilename, std::set<unsigned int> & integrationSteps) {
-  std::ifstream input;
-
-  input.open(inputFilename);
-  if ( !input ) {
-    throw FileError("ERROR: impossible to open integration steps file \"" + inputFilename + "\"");
-  }
-  while ( !input.eof() ) {
-    unsigned int step = observation.getNrSamplesPerBatch();
-
-    input >> step;
-    if ( step < observation.getNrSamplesPerBatch() ) {
-      integrationSteps.insert(step);
-    }
+void appendRawFile(ConcatenatedSource & source, Observation & observation, const Observation & fileObservation, const std::string & filename, const uint64_t bytesToSkip, const uint8_t inputBits) {
+  if ( source.getNrSources() == 0 ) {
+    observation = fileObservation;
+  } else if ( fileObservation.getLayoutHash() != observation.getLayoutHash() || fileObservation.getSamplingTime() != observation.getSamplingTime() || fileObservation.getMinFreq() != observation.getMinFreq() || fileObservation.getChannelBandwidth() != observation.getChannelBandwidth() ) {
+    throw ObservationError("ERROR: the header of \"" + filename + "\" does not match the previous files of the observation");
   }
-  input.close();
+  source.append(std::unique_ptr<ByteSource>(new PreadSource(filename)), bytesToSkip);
+  // A batch may straddle two files, only the last incomplete batch is dropped
+  observation.setNrBatches(source.getSize() / ((static_cast<uint64_t>(observation.getNrSamplesPerBatch()) * observation.getNrChannels() * inputBits) / 8));
 }
 
 #ifdef HAVE_PSRDADA
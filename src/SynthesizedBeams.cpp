@@ -20,20 +20,27 @@
 namespace AstroData {
 
 void generateBeamMapping(const AstroData::Observation & observation, std::vector<unsigned int> & beamMapping, const unsigned int padding, const bool subbanding) {
+  if ( !subbanding ) {
+    generateBeamMapping(BatchLayout<unsigned int>(observation, padding), observation, beamMapping);
+    return;
+  }
+  const unsigned int stride = observation.getNrSubbands(padding / sizeof(unsigned int));
+
   for ( unsigned int beam = 0; beam < observation.getNrSynthesizedBeams(); beam++ ) {
-    if ( subbanding) {
-      for ( unsigned int subband = 0; subband < observation.getNrSubbands(); subband++ ) {
-        beamMapping[(beam * observation.getNrSubbands(padding / sizeof(unsigned int))) + subband] = beam % observation.getNrBeams();
-      }
-    } else {
-      for ( unsigned int channel = 0; channel < observation.getNrChannels(); channel++ ) {
-        beamMapping[(beam * observation.getNrChannels(padding / sizeof(unsigned int))) + channel] = beam % observation.getNrBeams();
-      }
+    const unsigned int mappedBeam = beam % observation.getNrBeams();
+
+    for ( unsigned int subband = 0; subband < observation.getNrSubbands(); subband++ ) {
+      beamMapping[(beam * stride) + subband] = mappedBeam;
     }
   }
 }
 
 void readBeamMapping(const AstroData::Observation & observation, const std::string & inputFilename, std::vector<unsigned int> & beamMapping, const unsigned int padding, const bool subbanding) {
+  if ( !subbanding ) {
+    readBeamMapping(BatchLayout<unsigned int>(observation, padding), observation, inputFilename, beamMapping);
+    return;
+  }
+  const unsigned int stride = observation.getNrSubbands(padding / sizeof(unsigned int));
   std::ifstream inputFile;
 
   inputFile.open(inputFilename);
@@ -41,14 +48,8 @@ void readBeamMapping(const AstroData::Observation & observation, const std::stri
     throw FileError("Impossible to open " + inputFilename);
   }
   for ( unsigned int sBeam = 0; sBeam < observation.getNrSynthesizedBeams(); sBeam++ ) {
-    if ( subbanding ) {
-      for ( unsigned int subband = 0; subband < observation.getNrSubbands(); subband++ ) {
-        inputFile >> beamMapping[(sBeam * observation.getNrSubbands(padding / sizeof(unsigned int))) + subband];
-      }
-    } else {
-      for ( unsigned int channel = 0; channel < observation.getNrChannels(); channel++ ) {
-        inputFile >> beamMapping[(sBeam * observation.getNrChannels(padding / sizeof(unsigned int))) + channel];
-      }
+    for ( unsigned int subband = 0; subband < observation.getNrSubbands(); subband++ ) {
+      inputFile >> beamMapping[(sBeam * stride) + subband];
     }
   }
   inputFile.close();
@@ -0,0 +1,266 @@
+// Copyright 2017 Netherlands Institute for Radio Astronomy (ASTRON)
+// Copyright 2017 Netherlands eScience Center
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+#include <Tuning.hpp>
+#include <BatchLayout.hpp>
+#include <ReadData.hpp>
+#include <SynthesizedBeams.hpp>
+
+namespace {
+
+// First line of a sysfs file, empty if it does not exist
+std::string readLine(const std::string & filename) {
+  std::ifstream input(filename);
+  std::string line;
+
+  std::getline(input, line);
+  return line;
+}
+
+// Sizes such as "32K" or "8M"
+uint64_t parseSize(const std::string & size) {
+  uint64_t value = 0;
+  unsigned int position = 0;
+
+  while ( position < size.size() && std::isdigit(static_cast<unsigned char>(size.at(position))) ) {
+    value = (value * 10) + (size.at(position) - '0');
+    position++;
+  }
+  if ( position < size.size() ) {
+    if ( size.at(position) == 'K' ) {
+      value *= 1024;
+    } else if ( size.at(position) == 'M' ) {
+      value *= 1024 * 1024;
+    } else if ( size.at(position) == 'G' ) {
+      value *= 1024 * 1024 * 1024;
+    }
+  }
+  return value;
+}
+
+// Mean time of function, repeated for at least minTime seconds
+double timeKernel(const double minTime, const std::function<void()> & function) {
+  double elapsed = 0.0;
+  unsigned int iterations = 0;
+
+  // Warm up caches and first touch
+  function();
+  while ( elapsed < minTime || iterations == 0 ) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    function();
+    elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    iterations++;
+  }
+  return elapsed / iterations;
+}
+
+template<typename T> void deleteBatches(std::vector<std::vector<T> *> & data) {
+  for ( unsigned int batch = 0; batch < data.size(); batch++ ) {
+    delete data.at(batch);
+    data.at(batch) = 0;
+  }
+}
+
+} // namespace
+
+namespace AstroData {
+
+CPUInfo getCPUInfo() {
+  CPUInfo cpu;
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+
+  cpu.vectorWidth = 16;
+  cpu.cacheLineSize = 64;
+  while ( std::getline(cpuinfo, line) ) {
+    const std::string::size_type separator = line.find(':');
+
+    if ( separator == std::string::npos ) {
+      // Only the first processor is described
+      if ( !cpu.model.empty() ) {
+        break;
+      }
+      continue;
+    }
+    std::string key = line.substr(0, separator);
+    std::string value = line.substr(separator + 1);
+    std::istringstream values(value);
+
+    key.erase(key.find_last_not_of(" \t") + 1);
+    value.erase(0, value.find_first_not_of(" \t"));
+    if ( key == "model name" ) {
+      cpu.model = value;
+    } else if ( key == "flags" || key == "Features" ) {
+      std::string flag;
+
+      while ( values >> flag ) {
+        if ( flag == "avx512f" ) {
+          cpu.vectorWidth = std::max(cpu.vectorWidth, 64u);
+        } else if ( flag == "avx" || flag == "avx2" ) {
+          cpu.vectorWidth = std::max(cpu.vectorWidth, 32u);
+        }
+      }
+    }
+  }
+  for ( unsigned int index = 0; ; index++ ) {
+    const std::string directory = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+    const std::string type = readLine(directory + "type");
+    CacheInfo cache;
+
+    if ( type.empty() ) {
+      break;
+    }
+    if ( type == "Instruction" ) {
+      continue;
+    }
+    cache.level = std::stoul("0" + readLine(directory + "level"));
+    cache.size = parseSize(readLine(directory + "size"));
+    cache.lineSize = std::stoul("0" + readLine(directory + "coherency_line_size"));
+    cache.ways = std::stoul("0" + readLine(directory + "ways_of_associativity"));
+    if ( cache.level == 1 && cache.lineSize > 0 ) {
+      cpu.cacheLineSize = cache.lineSize;
+    }
+    cpu.caches.push_back(cache);
+  }
+  return cpu;
+}
+
+std::string getDeviceName(const CPUInfo & cpu) {
+  std::string name;
+
+  for ( unsigned int character = 0; character < cpu.model.size(); character++ ) {
+    if ( std::isalnum(static_cast<unsigned char>(cpu.model.at(character))) ) {
+      name += cpu.model.at(character);
+    } else if ( !name.empty() && name.back() != '_' ) {
+      name += '_';
+    }
+  }
+  while ( !name.empty() && name.back() == '_' ) {
+    name.pop_back();
+  }
+  // Configuration lines must start with a letter
+  if ( name.empty() || !std::isalpha(static_cast<unsigned char>(name.front())) ) {
+    name = "cpu" + (name.empty() ? "" : "_" + name);
+  }
+  return name;
+}
+
+std::vector<unsigned int> getCandidatePaddings(const CPUInfo & cpu) {
+  std::vector<unsigned int> paddings;
+
+  for ( unsigned int padding = cpu.vectorWidth; padding <= 4096; padding *= 2 ) {
+    paddings.push_back(padding);
+  }
+  // Strides that are not a large power of two spread channels over more cache sets
+  for ( unsigned int multiple = 3; multiple <= 7; multiple += 2 ) {
+    paddings.push_back(multiple * cpu.cacheLineSize);
+  }
+  std::sort(paddings.begin(), paddings.end());
+  paddings.erase(std::unique(paddings.begin(), paddings.end()), paddings.end());
+  return paddings;
+}
+
+std::vector<TuningResult> tunePadding(const Observation & observation, const std::vector<unsigned int> & paddings, const double minTime) {
+  std::vector<TuningResult> results;
+  const uint64_t nrInputBytes = (static_cast<uint64_t>(observation.getNrChannels()) * observation.getNrSamplesPerBatch() * observation.getNrBatches());
+  std::vector<uint8_t> raw(nrInputBytes);
+
+  for ( uint64_t byte = 0; byte < raw.size(); byte++ ) {
+    raw.at(byte) = static_cast<uint8_t>((byte * 2654435761u) >> 13);
+  }
+  MemorySource source(raw);
+
+  for ( unsigned int candidate = 0; candidate < paddings.size(); candidate++ ) {
+    const unsigned int padding = paddings.at(candidate);
+    BatchLayout<uint8_t> transposed(observation, padding, 8);
+    BatchLayout<uint8_t> packed(observation, padding, 2);
+    BatchLayout<float> unpacked(observation, padding, 32);
+    std::vector<std::vector<uint8_t> *> data(observation.getNrBatches());
+    std::vector<uint8_t> packedBatch(packed.getNrElementsPerBatch());
+    std::vector<float> unpackedBatch(unpacked.getNrElementsPerBatch());
+    std::vector<unsigned int> beamMapping(static_cast<uint64_t>(observation.getNrSynthesizedBeams()) * transposed.getBeamMappingStride());
+    TuningResult result;
+
+    result.padding = padding;
+    result.time = timeKernel(minTime, [&]() {
+      readSIGPROC(transposed, observation, source, 0, data);
+      deleteBatches(data);
+    });
+    if ( observation.getNrSamplesPerBatch() % packed.getNrSamplesPerElement() == 0 ) {
+      result.time += observation.getNrBatches() * timeKernel(minTime, [&]() {
+        convertBatch(packed, packedBatch.data(), unpacked, unpackedBatch.data());
+      });
+    }
+    // The beam mapping is generated once per observation
+    result.time += timeKernel(minTime, [&]() {
+      generateBeamMapping(transposed, observation, beamMapping);
+    });
+    results.push_back(result);
+  }
+  // Ties go to the smaller padding, that uses less memory
+  std::stable_sort(results.begin(), results.end(), [](const TuningResult & a, const TuningResult & b) {
+    return a.time < b.time;
+  });
+  return results;
+}
+
+void writeDeviceConf(const std::string & filename, const std::string & deviceName, const unsigned int value) {
+  std::ifstream input(filename);
+  std::vector<std::string> lines;
+  std::string line;
+  bool found = false;
+
+  if ( deviceName.empty() || !std::isalpha(static_cast<unsigned char>(deviceName.front())) || deviceName.find_first_of(" \t\n") != std::string::npos ) {
+    throw FileError("ERROR: impossible to store device \"" + deviceName + "\" in \"" + filename + "\"");
+  }
+  while ( std::getline(input, line) ) {
+    if ( line.compare(0, deviceName.size() + 1, deviceName + " ") == 0 ) {
+      if ( found ) {
+        continue;
+      }
+      line = deviceName + " " + std::to_string(value);
+      found = true;
+    }
+    lines.push_back(line);
+  }
+  input.close();
+  if ( !found ) {
+    lines.push_back(deviceName + " " + std::to_string(value));
+  }
+  // Replace the file at once, other workers may be reading it
+  const std::string temporary = filename + ".tmp";
+  std::ofstream output(temporary);
+
+  for ( unsigned int item = 0; item < lines.size(); item++ ) {
+    output << lines.at(item) << "\n";
+  }
+  output.close();
+  if ( !output || std::rename(temporary.c_str(), filename.c_str()) != 0 ) {
+    std::remove(temporary.c_str());
+    throw FileError("ERROR: impossible to write \"" + filename + "\"");
+  }
+}
+
+} // AstroData
+